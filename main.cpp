@@ -6,16 +6,66 @@
 
 #include "EasyBMP.h"
 #include "z80ex_dasm.h"
+#include "z88_sym.h"
+#include "z88_cov.h"
+#include "z88_mem.h"
+#include "z88_job.h"
+#include "z88_input.h"
+#include "z88_kbd.h"
+#include "z88_ps2.h"
+#include "z88_probe.h"
+#include "z88_btrace.h"
+#include "z88_tcheck.h"
+
+// RTC time scale, turbo mode, bus arbitration, RAM prefetch, ROM cache,
+// ROM shadowing, PC trace buffer, block move engine, short (IX+d) / I/O
+// cycles (set in the compile script)
+#ifndef RTC_SCALE
+#define RTC_SCALE 1
+#endif
+#if (RTC_SCALE < 1) || (RTC_SCALE > 31250) || (31250 % RTC_SCALE)
+#error "RTC_SCALE must divide 31250"
+#endif
+#ifndef TURBO
+#define TURBO 0
+#endif
+#ifndef BUS_ARB
+#define BUS_ARB 0
+#endif
+#ifndef RAM_PREFETCH
+#define RAM_PREFETCH 0
+#endif
+#ifndef ROM_CACHE
+#define ROM_CACHE 0
+#endif
+#ifndef ROM_SHADOW
+#define ROM_SHADOW 0
+#endif
+#ifndef PC_TRACE
+#define PC_TRACE 0
+#endif
+#ifndef BLOCK_MOVE
+#define BLOCK_MOVE 0
+#endif
+#ifndef SHORT_IX_IO
+#define SHORT_IX_IO 0
+#endif
+#ifndef ATTR_CACHE
+#define ATTR_CACHE 0
+#endif
+
+// Shadow ROM : banks $00 - $0F in the upper half of the SRAM
+#define SHADOW_SIZE 0x040000
+#define SHADOW_BASE (MEM_RAM_BASE + SHADOW_SIZE)
+
+// Simulated internal RAM (RAM_ADDR_MASK of z88_de1_top)
+#define SIM_RAM_SIZE 0x008000
 
 #include "Vz88_de1_top.h"
-#include "Vz88_de1_top_z88_de1_top.h"
-#include "Vz88_de1_top_z88_top__R7fff.h"
-#include "Vz88_de1_top_z88_blink.h"
-#include "Vz88_de1_top_tv80s.h"
-#include "Vz88_de1_top_tv80_reg.h"
-#include "Vz88_de1_top_tv80_core__M0.h"
 
 #include <ctime>
+#include <climits>
+#include <unistd.h>
 
 #if VM_TRACE
 #include "verilated_vcd_c.h"
@@ -26,8 +76,6 @@
 // Half period (in ps) of a 50 MHz clock
 #define STEP_PS      ((vluint64_t)10000)
 
-#define ROM_SIZE      (1<<19)
-#define RAM_SIZE      (1<<18)
 #define VRAM_SIZE     (1<<15)
 
 #define TIME_SPLIT    ((vluint64_t)16800000000)
@@ -38,10 +86,6 @@ vluint64_t tb_time;
 
 
 Vz88_de1_top* top;
-vluint8_t ROM[ROM_SIZE];
-size_t rom_size;
-vluint8_t RAM_U[RAM_SIZE];
-vluint8_t RAM_L[RAM_SIZE];
 vluint8_t VRAM[VRAM_SIZE];
 
 // Disassembly
@@ -66,18 +110,215 @@ Z80EX_BYTE disas_readbyte(Z80EX_WORD addr, Z80EX_BYTE bank) {
 
 Z80EX_BYTE disas_readbyte_top(Z80EX_WORD addr, Z80EX_BYTE unused) {
   if (disas_rom)
-    return ROM[addr & (rom_size - 1)];
+    return z88_mem->read(MEM_ROM_BASE | addr);
   if (disas_ram)
-  {
-      if (addr & 1)
-          return RAM_U[(addr >> 1) & (RAM_SIZE - 1)];
-      else
-          return RAM_L[(addr >> 1) & (RAM_SIZE - 1)];
-  }
+    return z88_mem->read(MEM_RAM_BASE | addr);
   fprintf(logger, "PC: Unexpected location %04X\n", addr);
   return 0xFF;
 }
 
+// Bank mapped at a logical address (Blink segments)
+int addr_bank(int addr, int com, const int *sr) {
+  // 0000-1FFF : Bank $00 !RAMS, Bank $20 RAMS
+  if (!(addr >> 13))
+    return (com & 0x04) ? 0x20 : 0x00;
+  // 2000-FFFF : SR0..SR3
+  return sr[(addr >> 14) & 3];
+}
+
+// Physical address of a logical address (Blink segments)
+unsigned phy_addr(int addr, int com, const int *sr) {
+  // 0000-1FFF : Bank $00 !RAMS, Bank $20 RAMS
+  if (!(addr >> 13))
+    return ((com & 0x04) ? 0x20 << 14 : 0) | (addr & 0x1FFF);
+  // 2000-3FFF : SR0 (8 KB half bank)
+  if (!(addr >> 14))
+    return ((sr[0] & 0xFE) << 14) | ((sr[0] & 0x01) << 13) | (addr & 0x1FFF);
+  // 4000-FFFF : SR1..SR3
+  return (sr[(addr >> 14) & 3] << 14) | (addr & 0x3FFF);
+}
+
+// Testbench option : job option first, then command line
+const char *tb_plus_match(const char *prefix) {
+  const char *arg = job_plus_match(prefix);
+  return (arg) ? arg : Verilated::commandArgsPlusMatch(prefix);
+}
+
+// Simulation duration : +usec=<num>, +msec=<num> or +sec=<num>
+vluint64_t tb_duration(const char *(*plus_match)(const char *), vluint64_t steps) {
+  const char *arg;
+
+  arg = plus_match("usec=");
+  if ((arg) && (arg[0]))
+    steps = (vluint64_t)atoi(arg + 6) * (vluint64_t)1000000L / STEP_PS;
+  arg = plus_match("msec=");
+  if ((arg) && (arg[0]))
+    steps = (vluint64_t)atoi(arg + 6) * (vluint64_t)1000000000L / STEP_PS;
+  arg = plus_match("sec=");
+  if ((arg) && (arg[0]))
+    steps = (vluint64_t)atoi(arg + 5) * (vluint64_t)1000000000000L / STEP_PS;
+  return steps;
+}
+
+// Internal ROM written by the testbench
+bool tb_rom_wr;
+
+// Host write, the shadow ROM copy follows the ROM
+void tb_poke(unsigned phy, uint8_t data) {
+  z88_mem->poke(phy, data);
+  if (ROM_SHADOW && (phy < SHADOW_SIZE)) z88_mem->poke(SHADOW_BASE + phy, data);
+  if (phy < MEM_RAM_BASE) tb_rom_wr = true;
+}
+
+// ROM written during the run : the ROM cache lines are cleared again
+// (cleared after reset anyway)
+void tb_rom_sync(Vz88_de1_top *top) {
+  if (ROM_CACHE && tb_rom_wr) top->RC_CLR_TGL ^= 1;
+  tb_rom_wr = false;
+}
+
+// ROM shadowing : the copy done by the hardware at reset, before the run
+void tb_shadow(void) {
+  for (unsigned phy = 0; phy < SHADOW_SIZE; phy++)
+    z88_mem->poke(SHADOW_BASE + phy, z88_mem->read(MEM_ROM_BASE + phy));
+  printf("ROM banks 00-0F shadowed at %06X-%06X, internal RAM limited to 256 KB.\n",
+         SHADOW_BASE, SHADOW_BASE + SHADOW_SIZE - 1);
+}
+
+// Memory patches : +patch=<BBXXXX>:<hex bytes>[,...] (bank, offset in bank)
+void tb_patch(const char *arg) {
+  char patches[256];
+
+  strncpy(patches, arg, sizeof(patches) - 1);
+  patches[sizeof(patches) - 1] = '\0';
+  for (char *p = strtok(patches, ","); p; p = strtok(NULL, ",")) {
+    char *data = strchr(p, ':');
+    unsigned addr = strtoul(p, NULL, 16);
+    unsigned phy = ((addr >> 16) << 14) | (addr & 0x3FFF);
+    int len = 0;
+
+    if (data == NULL) continue;
+    for (data++; isxdigit(data[0]) && isxdigit(data[1]); data += 2) {
+      char hex[3] = { data[0], data[1], 0 };
+      tb_poke(phy + len++, strtoul(hex, NULL, 16));
+    }
+    printf("Patched %d bytes at %02X:%04X\n", len, addr >> 16, addr & 0x3FFF);
+  }
+}
+
+// Direct load : "<file>@BB:XXXX[,...]" (bank BB, offset XXXX from the bank
+// start, a file may span several banks), returns false if a load failed
+bool tb_load(const char *arg) {
+  char loads[256];
+  bool ok = true;
+
+  strncpy(loads, arg, sizeof(loads) - 1);
+  loads[sizeof(loads) - 1] = '\0';
+  for (char *p = strtok(loads, ","); p; p = strtok(NULL, ",")) {
+    char *at = strrchr(p, '@');
+    unsigned bank, offs;
+    FILE *fh;
+    int len = 0;
+    int c;
+
+    if ((at == NULL) || (sscanf(at + 1, "%x:%x", &bank, &offs) != 2)) {
+      printf("Bad load \"%s\"\n", p);
+      ok = false;
+      continue;
+    }
+    *at = '\0';
+    fh = fopen(job_input(p).c_str(), "rb");
+    if (fh == NULL) {
+      printf("Cannot open \"%s\".\n", p);
+      ok = false;
+      continue;
+    }
+    while ((c = fgetc(fh)) != EOF) tb_poke((bank << 14) + offs + len++, c);
+    fclose(fh);
+    printf("Loaded %d bytes from \"%s\" at %02X:%04X\n", len, p, bank, offs);
+  }
+  return ok;
+}
+
+// Hand-off to loaded code : "PPPP[:SSSS]", jumps to PC PPPP (logical
+// address) at the next instruction, with SP = SSSS if given
+void tb_jump(Vz88_de1_top *top, const char *arg) {
+  unsigned pc = 0;
+  unsigned sp = 0;
+  vluint64_t inj = 0;
+  int len = 0;
+
+  if (sscanf(arg, "%x:%x", &pc, &sp) < 1) return;
+  // LD SP,SSSS
+  if (strchr(arg, ':')) {
+    inj |= (vluint64_t)0x31 << (len++ * 8);
+    inj |= (vluint64_t)(sp & 0xFF) << (len++ * 8);
+    inj |= (vluint64_t)(sp >> 8) << (len++ * 8);
+  }
+  // JP PPPP
+  inj |= (vluint64_t)0xC3 << (len++ * 8);
+  inj |= (vluint64_t)(pc & 0xFF) << (len++ * 8);
+  inj |= (vluint64_t)(pc >> 8) << (len++ * 8);
+
+  top->CPU_INJ     = inj;
+  top->CPU_INJ_LEN = len;
+  top->CPU_INJ_TGL ^= 1;
+  printf("Jump to %04X", pc);
+  if (strchr(arg, ':')) printf(", SP = %04X", sp);
+  printf("\n");
+}
+
+// PC trace buffer : "BB:PPPP" lines (bank, PC), oldest first, read through
+// the PCT_IDX / PCT_DAT port (no clock edge)
+void tb_pctrace(Vz88_de1_top *top, const char *file_name) {
+  const WData *prb = top->DBG_PROBE;
+  unsigned size = 1 << PC_TRACE;
+  unsigned wrp = PRB_PCT_WRP(prb);
+  unsigned num = (PRB_PCT_FULL(prb)) ? size : wrp;
+  FILE *fh = fopen(file_name, "w");
+
+  if (fh == NULL) {
+    printf("Cannot create PC trace \"%s\".\n", file_name);
+    return;
+  }
+  for (unsigned i = 0; i < num; i++) {
+    top->PCT_IDX = (PRB_PCT_FULL(prb)) ? (wrp + i) & (size - 1) : i;
+    top->eval();
+    fprintf(fh, "%02X:%04X\n", top->PCT_DAT >> 16, top->PCT_DAT & 0xFFFF);
+  }
+  fclose(fh);
+  printf("PC trace : %u fetches written to \"%s\"%s\n", num, file_name,
+         (PRB_PCT_FRZ(prb)) ? " (frozen by a trigger)" : "");
+}
+
+// Time-parallel tracing : forks the re-simulation of the segment starting at
+// frame "idx", returns true in the child
+bool tb_segment(int idx, int jobs) {
+  char name[32];
+
+  while (job_active() >= jobs) job_wait();
+
+  sprintf(name, "seg_%04d", idx);
+  if (!job_start(job_add(name))) return false;
+
+  // Console output of the segment
+  sprintf(name, "z88_seg_%04d.out", idx);
+  if (!freopen(name, "w", stdout)) _exit(-1);
+  return true;
+}
+
+// Symbol of the first 16-bit operand ("#XXXX") of a disassembled instruction
+int operand_symbol(char *out, int out_size, const char *disas, int com, const int *sr) {
+  for (const char *p = strchr(disas, '#'); p; p = strchr(p + 1, '#')) {
+    int len = strspn(p + 1, "0123456789ABCDEF");
+    if (len == 4) {
+      int addr = strtol(p + 1, NULL, 16);
+      return sym_format(out, out_size, addr_bank(addr, com, sr), addr);
+    }
+  }
+  return 0;
+}
+
 int main(int argc, char **argv, char **env)
 {
     vluint16_t fr_tgl;
@@ -87,6 +328,9 @@ int main(int argc, char **argv, char **env)
     int log_idx = 0;
     int trc_idx = 0;
     int min_idx = 0;
+    int max_idx = INT_MAX;
+    int bmp_min = 0;
+    #define TB_TRACED(idx) (((idx) >= min_idx) && ((idx) < max_idx))
     // File name generation
     char file_name[256];
     // Simulation duration
@@ -105,32 +349,71 @@ int main(int argc, char **argv, char **env)
 
     Verilated::commandArgs(argc, argv);
 
-    // Simulation duration : +usec=<num>
-    arg = Verilated::commandArgsPlusMatch("usec=");
+    // Number of processes for batches and scenarios : +jobs=<num> (default : number of cores)
+    int max_jobs = sysconf(_SC_NPROCESSORS_ONLN);
+    arg = tb_plus_match("jobs=");
     if ((arg) && (arg[0]))
     {
-        arg += 6;
-        max_step = (vluint64_t)atoi(arg) * (vluint64_t)1000000L / STEP_PS;
+        max_jobs = atoi(arg + 6);
     }
 
-    // Simulation duration : +msec=<num>
-    arg = Verilated::commandArgsPlusMatch("msec=");
+    // Batch : +batch=<job list>, one complete simulation per job
+    bool batch = false;
+    arg = tb_plus_match("batch=");
     if ((arg) && (arg[0]))
     {
-        arg += 6;
-        max_step = (vluint64_t)atoi(arg) * (vluint64_t)1000000000L / STEP_PS;
+        if (!job_load(arg + 7)) exit(-1);
+        if (job_run(max_jobs) < 0)
+        {
+            end = time(0);
+            exit(job_summary(difftime(end, beg)) ? -1 : 0);
+        }
+        batch = true;
+        beg   = time(0);
     }
 
-    // Simulation duration : +sec=<num>
-    arg = Verilated::commandArgsPlusMatch("sec=");
+    // Simulation duration : +usec=<num>, +msec=<num> or +sec=<num>
+    max_step = tb_duration(tb_plus_match, max_step);
+
+    // Scenarios forked at a given frame : +fork=<job list>, +fork_fr=<num>
+    int fork_fr = -1;
+    int job_fr = 0;
+    vluint64_t job_ps = 0;
+    arg = tb_plus_match("fork=");
+    if ((arg) && (arg[0]) && !batch)
+    {
+        if (!job_load(arg + 6)) exit(-1);
+        fork_fr = 1;
+        arg = tb_plus_match("fork_fr=");
+        if ((arg) && (arg[0])) fork_fr = atoi(arg + 9);
+    }
+
+    // Symbol maps : +sym=<file>[,<file>...]
+    arg = tb_plus_match("sym=");
     if ((arg) && (arg[0]))
     {
+        char sym_files[256];
         arg += 5;
-        max_step = (vluint64_t)atoi(arg) * (vluint64_t)1000000000000L / STEP_PS;
+        strncpy(sym_files, arg, sizeof(sym_files) - 1);
+        sym_files[sizeof(sym_files) - 1] = '\0';
+        for (char *f = strtok(sym_files, ","); f; f = strtok(NULL, ","))
+        {
+            sym_load(f);
+        }
+        sym_index();
+    }
+
+    // Coverage bitmaps, merged with a previous run : +cov=<file>
+    const char *cov_file = NULL;
+    arg = tb_plus_match("cov=");
+    if ((arg) && (arg[0]))
+    {
+        cov_file = arg + 5;
+        cov_load(cov_file);
     }
 
     // Trace start index : +tidx=<num>
-    arg = Verilated::commandArgsPlusMatch("tidx=");
+    arg = tb_plus_match("tidx=");
     if ((arg) && (arg[0]))
     {
         arg += 6;
@@ -141,8 +424,198 @@ int main(int argc, char **argv, char **env)
         min_idx = 0;
     }
 
+    // Time-parallel tracing : +tpar=<num>
+    // Fast pass without any output, each segment of <num> frames is re-simulated
+    // with all the outputs (DASM logs, BMP, VCD) by a child process
+    int tpar = 0;
+    int tpar_beg = 0;
+    arg = tb_plus_match("tpar=");
+    if ((arg) && (arg[0]) && !batch && (fork_fr < 0))
+    {
+        tpar     = atoi(arg + 6);
+        tpar_beg = min_idx;
+        min_idx  = bmp_min = INT_MAX;
+    }
+
+    // Physical memory (slot 0 ROM & RAM, empty card slots)
+    z88_mem = new Z88Memory;
+
+    // ROM image : +rom=<file> (default : oz47b.rom)
+    // Smaller ROMs are mirrored in the 512 KB area
+    const char *rom_file = "oz47b.rom";
+    //const char *rom_file = "Z88UK400.rom";
+    arg = tb_plus_match("rom=");
+    if ((arg) && (arg[0]))
+    {
+        rom_file = arg + 5;
+    }
+    size_t rom_size = z88_mem->map(MEM_ROM_BASE, MEM_RAM_BASE - MEM_ROM_BASE, MEM_ROM, rom_file);
+    if (rom_size == 0) {
+      printf("Cannot open ROM file for reading.\n");
+      exit(-1);
+    }
+    printf("ROM file \"%s\" %s as a %lu-bytes ROM.\n", rom_file,
+           (z88_mem->mapped(MEM_ROM_BASE)) ? "mapped" : "copied", rom_size);
+
+    // RAM image : +ram=<file>, +ram_mode=private|shared (default : private)
+    arg = tb_plus_match("ram=");
+    if ((arg) && (arg[0]))
+    {
+        const char *ram_file = arg + 5;
+        MemMapMode ram_mode = MEM_MAP_PRIVATE;
+
+        arg = tb_plus_match("ram_mode=");
+        if ((arg) && (arg[0]) && !strcmp(arg + 10, "shared"))
+        {
+            ram_mode = MEM_MAP_SHARED;
+        }
+        if (!z88_mem->map(MEM_RAM_BASE, MEM_SLOT_SIZE - MEM_RAM_BASE, MEM_RAM, ram_file,
+                          ram_mode, MEM_SLOT_SIZE - MEM_RAM_BASE))
+        {
+            exit(-1);
+        }
+        printf("RAM file \"%s\" %s (%s).\n", ram_file,
+               (z88_mem->mapped(MEM_RAM_BASE)) ? "mapped" : "copied",
+               (ram_mode == MEM_MAP_SHARED) ? "shared" : "private");
+    }
+    // The RAM banks are aliases of the simulated RAM (address mask), like
+    // for the Z80 : the host writes (+ram=, +patch=, +load=) go where it reads
+    z88_mem->set_region(MEM_RAM_BASE, (ROM_SHADOW) ? SHADOW_SIZE : MEM_SLOT_SIZE - MEM_RAM_BASE,
+                        MEM_RAM, SIM_RAM_SIZE);
+    printf("Internal RAM : %d KB, mirrored in banks 20-%02X.\n", SIM_RAM_SIZE >> 10,
+           ((ROM_SHADOW) ? SHADOW_BASE : MEM_SLOT_SIZE) / MEM_BANK_SIZE - 1);
+    if (ROM_SHADOW) tb_shadow();
+
+    // Cards : +card1..3=[eprom:|flash:|ram:]<file> or ram:<KB>
+    for (int slot = 1; slot <= 3; slot++)
+    {
+        char card_opt[8];
+        MemType type = MEM_EPROM;
+
+        sprintf(card_opt, "card%d=", slot);
+        arg = tb_plus_match(card_opt);
+        if (!(arg) || !(arg[0])) continue;
+
+        arg += 7;
+        if      (!strncmp(arg, "eprom:", 6)) { type = MEM_EPROM; arg += 6; }
+        else if (!strncmp(arg, "flash:", 6)) { type = MEM_FLASH; arg += 6; }
+        else if (!strncmp(arg, "ram:",   4)) { type = MEM_RAM;   arg += 4; }
+
+        if ((type == MEM_RAM) && (strspn(arg, "0123456789") == strlen(arg)))
+        {
+            // Empty RAM card
+            z88_mem->set_card(slot, MEM_RAM, atoi(arg) << 10);
+            printf("Slot %d : %d KB RAM card.\n", slot, atoi(arg));
+        }
+        else
+        {
+            if (!z88_mem->map(slot * MEM_SLOT_SIZE, MEM_SLOT_SIZE, type, arg)) exit(-1);
+            printf("Slot %d : card image \"%s\" %s.\n", slot, arg,
+                   (z88_mem->mapped(slot * MEM_SLOT_SIZE)) ? "mapped" : "copied");
+        }
+    }
+
+    // Memory patches : +patch=<BBXXXX>:<hex bytes>[,...]
+    arg = tb_plus_match("patch=");
+    if ((arg) && (arg[0]))
+    {
+        tb_patch(arg + 7);
+    }
+
+    // Direct load : +load=<file>@<BB:XXXX>[,...], +load_pc=<PPPP>[:<SSSS>],
+    // at frame +load_fr=<num> (default : before the reset)
+    const char *load_arg = tb_plus_match("load=");
+    const char *load_pc  = tb_plus_match("load_pc=");
+    int load_fr = 0;
+    arg = tb_plus_match("load_fr=");
+    if ((arg) && (arg[0])) load_fr = atoi(arg + 9);
+
+    // Batch job : the outputs go to the job directory, the input files and
+    // the coverage file (merged at start, written at exit) stay relative to
+    // the launch one
+    std::string cov_path;
+    if (batch) job_enter();
+    if ((batch) && (cov_file))
+    {
+        cov_path = job_input(cov_file);
+        cov_file = cov_path.c_str();
+    }
+
+    // Run header : simulation-only time scales
+    printf("RTC time scale : x%d%s\n", RTC_SCALE, (RTC_SCALE != 1) ? " (not real time)" : "");
+    printf("Z80 timing : %s\n", (TURBO) ? "turbo (not cycle accurate)" :
+           (BUS_ARB) ? "idle LCD windows lent to the Z80 (not cycle accurate)" : "cycle accurate");
+    if (SHORT_IX_IO) printf("tv80 profile : (IX+d) addressing 4 T-states shorter, no I/O wait state\n");
+    if (RAM_PREFETCH) printf("RAM prefetch buffer : on\n");
+    if (ROM_CACHE) printf("ROM cache : %d lines of 4 locations%s\n", 1 << ROM_CACHE,
+                          (TURBO || BUS_ARB) ? "" : " (no effect on the cycle accurate timing)");
+    if (BLOCK_MOVE) printf("Block move engine : LDIR / LDDR, when enabled by software (I/O $F5)\n");
+    if (ATTR_CACHE) printf("LCD attribute cache : on\n");
+
+    // Input log replay : +play=<file>
+    arg = tb_plus_match("play=");
+    if ((arg) && (arg[0]))
+    {
+        if (!in_play(job_input(arg + 6).c_str())) exit(-1);
+    }
+
+    // Input log recording : +rec=<file>
+    arg = tb_plus_match("rec=");
+    if ((arg) && (arg[0]))
+    {
+        if (!in_record(arg + 5)) exit(-1);
+    }
+
+    // PS/2 keyboard model : +ps2=fast|real
+    arg = tb_plus_match("ps2=");
+    if ((arg) && (arg[0]))
+    {
+        ps2_init(strcmp(arg + 5, "real") ? PS2_HALF_FAST : PS2_HALF_REAL);
+    }
+
+    // Bus tracer : +btrace=<file>, +btrace_len=<num>, +btrace_typ=<rwiof>,
+    // +btrace_rng=[p]<XXXX>-<YYYY>
+    arg = tb_plus_match("btrace=");
+    if ((arg) && (arg[0]))
+    {
+        const char *typ = tb_plus_match("btrace_typ=");
+        const char *rng = tb_plus_match("btrace_rng=");
+        const char *len = tb_plus_match("btrace_len=");
+
+        bt_open(arg + 8, (len) ? atoi(len + 12) : 1 << 20);
+        if (!bt_filter((typ) ? typ + 12 : NULL, (rng) ? rng + 12 : NULL)) exit(-1);
+    }
+
+    // Timing check against the Z80 T-states : +tcheck=<file>
+    arg = tb_plus_match("tcheck=");
+    if ((arg) && (arg[0])) tc_open(arg + 8, SHORT_IX_IO != 0);
+
+    // Keyboard script : +kbd=<file>
+    arg = tb_plus_match("kbd=");
+    if ((arg) && (arg[0]))
+    {
+        if (!kbd_load(job_input(arg + 5).c_str(), (vluint64_t)1000000000L / STEP_PS)) exit(-1);
+    }
+
     // Init top verilog instance
     top = new Vz88_de1_top;
+    // Debug probe words
+    const WData *prb = top->DBG_PROBE;
+
+    // First time-parallel segment
+    if ((tpar) && (tpar_beg == 0))
+    {
+        z88_mem->privatize();
+        if (tb_segment(0, max_jobs))
+        {
+            min_idx = bmp_min = 0;
+            max_idx = tpar;
+            cov_file = NULL;
+            in_record(NULL);
+            bt_open(NULL, 0);
+            tc_open(NULL, false);
+        }
+    }
 
 #if VM_TRACE
     // Init VCD trace dump
@@ -150,7 +623,7 @@ int main(int argc, char **argv, char **env)
     VerilatedVcdC* tfp = new VerilatedVcdC;
     top->trace (tfp, 99);
     tfp->spTrace()->set_time_resolution ("1 ps");
-    if (trc_idx == min_idx)
+    if (TB_TRACED(trc_idx) && (trc_idx == min_idx))
     {
         sprintf(file_name, "z88_%04d.vcd", trc_idx);
         printf("Opening VCD file \"%s\"\n", file_name);
@@ -159,40 +632,35 @@ int main(int argc, char **argv, char **env)
 #endif /* VM_TRACE */
 
     // Initialize simulation inputs
-    top->SW       = 0;
-    top->KEY      = 0;
+    top->SW       = in_get(IN_SW);
+    top->KEY      = in_get(IN_KEY);
     top->CLOCK_50 = 1;
 
     top->SRAM_D  = 0;
     top->FL_D    = 0;
 
-    top->PS2_CLK = 0;
-    top->PS2_DAT = 0;
+    top->PS2_CLK = in_get(IN_PS2_CLK);
+    top->PS2_DAT = in_get(IN_PS2_DAT);
+    top->KB_INJ  = in_get(IN_KB);
+    top->BTRACE  = bt_types();
+
+    top->CPU_INJ     = 0;
+    top->CPU_INJ_LEN = 0;
+    top->CPU_INJ_TGL = 0;
+    top->RC_CLR_TGL  = 0;
+    if (load_fr == 0)
+    {
+        if ((load_arg) && !tb_load(load_arg + 6)) exit(-1);
+        if (load_pc)  tb_jump(top, load_pc + 9);
+    }
+    tb_rom_wr = false;
 
     tb_sstep      = 0;  // Simulation steps (64 bits)
     tb_time       = 0;  // Simulation time in ps (64 bits)
     fr_tgl        = 0;
 
-    // Load the ROM file
-    //FILE *rom = fopen("Z88UK400.rom","rb");
-    FILE *rom = fopen("oz47b.rom","rb");
-    if (rom == NULL) {
-      printf("Cannot open ROM file for reading.\n");
-      exit(-1);
-    }
-    rom_size = fread(ROM, 1, ROM_SIZE, rom);
-    fclose(rom);
-    printf("Loaded %ld bytes from ROM file.\n", rom_size);
-    int rom_shift = 0;
-    while( (1 << rom_shift) < rom_size )
-      rom_shift++;
-    if ( (1 << rom_shift) != rom_size ) {
-      rom_size = 1 << rom_shift;
-      printf("ROM file packed into a %lu-bytes ROM.\n", rom_size);
-    }
-
     // For disassembly
-    if (log_idx == min_idx)
+    if (TB_TRACED(log_idx) && (log_idx == min_idx))
     {
         sprintf(file_name, "z88_dasm_%04d.log", log_idx);
         printf("Opening DASM file \"%s\"\n", file_name);
@@ -215,9 +683,9 @@ int main(int argc, char **argv, char **env)
     int regE;
     int regH;
     int regL;
-    int seg0;
-    int seg;
     int com;
+    int sr[4];
+    char sym_out[128];
     int regPC;
     int regSP;
     int regIX;
@@ -235,8 +703,19 @@ int main(int argc, char **argv, char **env)
     // Run simulation for NUM_CYCLES clock periods
     while (tb_sstep < max_step)
     {
+        // Inputs : live or replayed
+        in_step(tb_sstep);
+        bt_step(tb_sstep);
         // Reset ON during 15 cycles
-        top->KEY      = (tb_sstep < (vluint64_t)30) ? 0 : 3;
+        in_set(IN_KEY, (tb_sstep < (vluint64_t)30) ? 0 : 3);
+        kbd_update(tb_sstep, log_idx);
+        ps2_update(tb_sstep, top->PS2_CLK_OE, top->PS2_DAT_OE);
+
+        top->KEY      = in_get(IN_KEY);
+        top->SW       = in_get(IN_SW);
+        top->PS2_CLK  = in_get(IN_PS2_CLK);
+        top->PS2_DAT  = in_get(IN_PS2_DAT);
+        top->KB_INJ   = in_get(IN_KB);
         // Toggle clock
         top->CLOCK_50 = top->CLOCK_50 ^ 1;
 
@@ -254,7 +733,7 @@ int main(int argc, char **argv, char **env)
         {
             disas_rom  = true;
             disas_ram  = false;
-            rom_dly[0] = ROM[top->FL_ADDR & (ROM_SIZE-1)];
+            rom_dly[0] = z88_mem->flash_read(top->FL_ADDR);
         }
         else
         {
@@ -270,8 +749,7 @@ int main(int argc, char **argv, char **env)
         {
             disas_rom = false;
             disas_ram = true;
-            ram_dly   =  (vluint16_t)RAM_L[top->SRAM_ADDR & (RAM_SIZE-1)]
-                      | ((vluint16_t)RAM_U[top->SRAM_ADDR & (RAM_SIZE-1)] << 8);
+            ram_dly   = z88_mem->sram_read(top->SRAM_ADDR);
         }
         else
         {
@@ -282,32 +760,51 @@ int main(int argc, char **argv, char **env)
         // Write
         if (!top->SRAM_WE_N && !top->SRAM_CE_N)
         {
-            if (!top->SRAM_LB_N)
-                RAM_L[top->SRAM_ADDR & (RAM_SIZE-1)] = (vluint8_t)(top->SRAM_Q & 0xFF);
-            if (!top->SRAM_UB_N)
-                RAM_U[top->SRAM_ADDR & (RAM_SIZE-1)] = (vluint8_t)(top->SRAM_Q >> 8);
+            z88_mem->sram_write(top->SRAM_ADDR, top->SRAM_Q, !top->SRAM_LB_N, !top->SRAM_UB_N);
         }
 
         // Simulate VRAM behaviour
         if (top->CLOCK_50)
         {
-            if (top->z88_de1_top->the_z88->w_lcd_vram_we)
+            if (PRB_VRAM_WE(prb))
             {
-                VRAM[top->z88_de1_top->the_z88->w_lcd_vram_addr & (VRAM_SIZE-1)] =
-                    (top->z88_de1_top->the_z88->w_lcd_vram_data & 7);
+                VRAM[PRB_VRAM_ADDR(prb) & (VRAM_SIZE-1)] = PRB_VRAM_DATA(prb);
             }
         }
 
         // Evaluate verilated model
         top->eval();
 
+        // Timing check : once per clock period
+        if (top->CLOCK_50) tc_step(prb);
+
+        // Coverage : one bit per opcode fetch / data access
+        if (cov_file && !PRB_MREQ_N(prb) && PRB_CLK_ENA(prb))
+        {
+            int cov_sr[4];
+            cov_sr[0] = PRB_SR(prb, 0);
+            cov_sr[1] = PRB_SR(prb, 1);
+            cov_sr[2] = PRB_SR(prb, 2);
+            cov_sr[3] = PRB_SR(prb, 3);
+            unsigned phy = phy_addr(PRB_ADDR(prb), PRB_COM(prb), cov_sr);
+
+            if (!PRB_M1_N(prb))
+            {
+                if (m1_prev) cov_mark(cov_code, phy);
+            }
+            else
+            {
+                if (mreq_prev) cov_mark(cov_data, phy);
+            }
+        }
+
         // Disassembly
-        if (log_idx >= min_idx)
+        if (TB_TRACED(log_idx))
         {
-            if (!top->z88_de1_top->the_z88->w_z80_m1_n &&
-                !top->z88_de1_top->the_z88->w_z80_mreq_n &&
-                 top->z88_de1_top->the_z88->w_z80_clk_ena &&
-                 top->z88_de1_top->the_z88->w_z80_halt_n &&
+            if (!PRB_M1_N(prb) &&
+                !PRB_MREQ_N(prb) &&
+                 PRB_CLK_ENA(prb) &&
+                 PRB_HALT_N(prb) &&
                  m1_prev)
             {
                 if (first)
@@ -328,75 +825,131 @@ int main(int argc, char **argv, char **env)
                         //    fprintf(logger, "%02X ", opc[i]);
                         //}
                         //fprintf (logger, "\n", NULL);
-                        fprintf(logger, "%02X  "BYTETOBINARYPATTERN"  %02X%02X %02X%02X %02X%02X  %04X %04X  %04X\n",
+                        fprintf(logger, "%02X  "BYTETOBINARYPATTERN"  %02X%02X %02X%02X %02X%02X  %04X %04X  %04X",
                                 regA, BYTETOBINARY(regF), regB, regC, regD, regE, regH, regL, regIX, regIY, regSP);
+                        if (sym_count())
+                        {
+                            // Annotation : PC symbol, operand symbol
+                            if (sym_format(sym_out, sizeof(sym_out), bnk, regPC))
+                                fprintf(logger, "  ; %s", sym_out);
+                            else
+                                fprintf(logger, "  ; ");
+                            if (operand_symbol(sym_out, sizeof(sym_out), disas_out, com, sr))
+                                fprintf(logger, " -> %s", sym_out);
+                        }
+                        fprintf(logger, "\n");
                         opcn = 0;
                         opctime = tb_time;
                     }
                 }
                 first = true;
-                opc[opcn++] = top->z88_de1_top->the_z88->r_z80_rdata;
-                regPC = top->z88_de1_top->the_z88->the_z80->i_tv80_core->PC;
-                regSP = top->z88_de1_top->the_z88->the_z80->i_tv80_core->SP;
-                regA  = top->z88_de1_top->the_z88->the_z80->i_tv80_core->ACC;
-                regF  = top->z88_de1_top->the_z88->the_z80->i_tv80_core->F;
-                regB  = top->z88_de1_top->the_z88->the_z80->i_tv80_core->i_reg->B;
-                regC  = top->z88_de1_top->the_z88->the_z80->i_tv80_core->i_reg->C;
-                regD  = top->z88_de1_top->the_z88->the_z80->i_tv80_core->i_reg->D;
-                regE  = top->z88_de1_top->the_z88->the_z80->i_tv80_core->i_reg->E;
-                regH  = top->z88_de1_top->the_z88->the_z80->i_tv80_core->i_reg->H;
-                regL  = top->z88_de1_top->the_z88->the_z80->i_tv80_core->i_reg->L;
-                regIX = top->z88_de1_top->the_z88->the_z80->i_tv80_core->i_reg->IX;
-                regIY = top->z88_de1_top->the_z88->the_z80->i_tv80_core->i_reg->IY;
-                seg0  = (regPC>>13 & 0x07);
-                seg   = (regPC>>14 & 0x03);
-                com   = top->z88_de1_top->the_z88->the_blink->r_COM;
-
-                if (!seg0)
-                {
-                    if (com & 0x04)
-                    {
-                        bnk = 0x20;
-                    }
-                    else
-                    {
-                        bnk = 0X00;
-                    }
-                }
-                else
-                {
-                    switch (seg)
-                    {
-                        case 0: { bnk = top->z88_de1_top->the_z88->the_blink->r_SR0; break; }
-                        case 1: { bnk = top->z88_de1_top->the_z88->the_blink->r_SR1; break; }
-                        case 2: { bnk = top->z88_de1_top->the_z88->the_blink->r_SR2; break; }
-                        case 3: { bnk = top->z88_de1_top->the_z88->the_blink->r_SR3; break; }
-                    }
-                }
+                opc[opcn++] = PRB_RDATA(prb);
+                regPC = PRB_PC(prb);
+                regSP = PRB_SP(prb);
+                regA  = PRB_A(prb);
+                regF  = PRB_F(prb);
+                regB  = PRB_B(prb);
+                regC  = PRB_C(prb);
+                regD  = PRB_D(prb);
+                regE  = PRB_E(prb);
+                regH  = PRB_H(prb);
+                regL  = PRB_L(prb);
+                regIX = PRB_IX(prb);
+                regIY = PRB_IY(prb);
+                com   = PRB_COM(prb);
+                sr[0] = PRB_SR(prb, 0);
+                sr[1] = PRB_SR(prb, 1);
+                sr[2] = PRB_SR(prb, 2);
+                sr[3] = PRB_SR(prb, 3);
+                bnk   = addr_bank(regPC, com, sr);
             }
-            if (top->z88_de1_top->the_z88->w_z80_m1_n &&
-               !top->z88_de1_top->the_z88->w_z80_mreq_n &&
-                top->z88_de1_top->the_z88->w_z80_clk_ena &&
-                top->z88_de1_top->the_z88->w_z80_halt_n &&
+            if (PRB_M1_N(prb) &&
+               !PRB_MREQ_N(prb) &&
+                PRB_CLK_ENA(prb) &&
+                PRB_HALT_N(prb) &&
                 mreq_prev)
             {
-                opc[opcn++] = top->z88_de1_top->the_z88->r_z80_rdata;
+                opc[opcn++] = PRB_RDATA(prb);
             }
         }
-        m1_prev  = !top->z88_de1_top->the_z88->w_z80_m1_n &&
-                   !top->z88_de1_top->the_z88->w_z80_mreq_n &&
-                    top->z88_de1_top->the_z88->w_z80_clk_ena;
+        m1_prev  = !PRB_M1_N(prb) &&
+                   !PRB_MREQ_N(prb) &&
+                    PRB_CLK_ENA(prb);
 
-        mreq_prev = top->z88_de1_top->the_z88->w_z80_m1_n &&
-                   !top->z88_de1_top->the_z88->w_z80_mreq_n &&
-                    top->z88_de1_top->the_z88->w_z80_clk_ena;
+        mreq_prev = PRB_M1_N(prb) &&
+                   !PRB_MREQ_N(prb) &&
+                    PRB_CLK_ENA(prb);
 
-        if (fr_tgl != top->z88_de1_top->the_z88->w_vga_fr_tgl)
+        if (fr_tgl != PRB_FR_TGL(prb))
         {
             // New log file
-            if (log_idx >= min_idx) fclose(logger);
+            if (TB_TRACED(log_idx)) fclose(logger);
             log_idx++;
-            if (log_idx >= min_idx)
+            // Time-parallel segment
+            if ((tpar) && (job_self < 0) && (log_idx >= tpar_beg) && !((log_idx - tpar_beg) % tpar))
+            {
+                z88_mem->privatize();
+                if (tb_segment(log_idx, max_jobs))
+                {
+                    min_idx  = bmp_min = log_idx;
+                    max_idx  = log_idx + tpar;
+                    cov_file = NULL;
+                    in_record(NULL);
+                    bt_open(NULL, 0);
+                    tc_open(NULL, false);
+                    top->BTRACE = 0;
+                    beg      = time(0);
+                    job_fr   = log_idx;
+                    job_ps   = tb_time;
+                }
+            }
+            // Direct load
+            if (log_idx == load_fr)
+            {
+                if ((load_arg) && !tb_load(load_arg + 6)) exit(-1);
+                if (load_pc)  tb_jump(top, load_pc + 9);
+            }
+            // End of the traced window
+            if (log_idx == max_idx) max_step = tb_sstep + 1;
+            // Scenarios : the jobs continue from the current state
+            if (log_idx == fork_fr)
+            {
+#if VM_TRACE
+                if (tfp) tfp->close();
+#endif
+                z88_mem->privatize();
+                if (job_run(max_jobs) < 0)
+                {
+                    end = time(0);
+                    exit(job_summary(difftime(end, beg)) ? -1 : 0);
+                }
+                job_enter();
+                beg      = time(0);
+                job_fr   = log_idx;
+                job_ps   = tb_time;
+                max_step = tb_sstep + tb_duration(job_plus_match, max_step - tb_sstep);
+                arg = job_plus_match("patch=");
+                if (arg) tb_patch(arg + 7);
+                // Inputs and coverage file relative to the launch directory,
+                // input log in the scenario directory
+                arg = job_plus_match("cov=");
+                if (arg)
+                {
+                    cov_path = job_input(arg + 5);
+                    cov_file = cov_path.c_str();
+                    cov_load(cov_file);
+                }
+                arg = job_plus_match("rec=");
+                if (!in_record((arg) ? arg + 5 : NULL)) exit(-1);
+                arg = job_plus_match("kbd=");
+                if ((arg) && !kbd_load(job_input(arg + 5).c_str(), (vluint64_t)1000000000L / STEP_PS)) exit(-1);
+                arg = job_plus_match("load=");
+                if ((arg) && !tb_load(arg + 6)) exit(-1);
+                arg = job_plus_match("load_pc=");
+                if (arg) tb_jump(top, arg + 9);
+            }
+            tb_rom_sync(top);
+            if (TB_TRACED(log_idx))
             {
                 sprintf(file_name, "z88_dasm_%04d.log", log_idx);
                 printf("Opening DASM file \"%s\"\n", file_name);
@@ -410,26 +963,27 @@ int main(int argc, char **argv, char **env)
         // Dump signals into VCD file
         if (tfp)
         {
-            if (fr_tgl != top->z88_de1_top->the_z88->w_vga_fr_tgl)
+            if (fr_tgl != PRB_FR_TGL(prb))
             {
                 // New VCD file
-                if (trc_idx >= min_idx) tfp->close();
+                if (TB_TRACED(trc_idx)) tfp->close();
                 trc_idx++;
-                if (trc_idx >= min_idx)
+                if (TB_TRACED(trc_idx))
                 {
                     sprintf(file_name, "z88_%04d.vcd", trc_idx);
                     printf("Opening VCD file \"%s\"\n", file_name);
                     tfp->open (file_name);
                 }
             }
-            if (trc_idx >= min_idx)
+            if (TB_TRACED(trc_idx))
             {
                 tfp->dump(tb_time);
             }
         }
 #endif /* VM_TRACE */
 
-        if (fr_tgl != top->z88_de1_top->the_z88->w_vga_fr_tgl)
+        if ((fr_tgl != PRB_FR_TGL(prb)) &&
+            (bmp_idx >= bmp_min) && (bmp_idx < max_idx))
         {
             for (int y = 0; y < 64; y++)
             {
@@ -491,8 +1045,11 @@ int main(int argc, char **argv, char **env)
             }
             sprintf(file_name, "vid_%04d.bmp", bmp_idx);
             bmp->WriteToFile(file_name);
+        }
+        if (fr_tgl != PRB_FR_TGL(prb))
+        {
             bmp_idx++;
-            fr_tgl = top->z88_de1_top->the_z88->w_vga_fr_tgl;
+            fr_tgl = PRB_FR_TGL(prb);
         }
 
         // Next simulation step
@@ -507,8 +1064,54 @@ int main(int argc, char **argv, char **env)
 
         if (Verilated::gotFinish()) break;
     }
+    // PC trace buffer : +pctrace=<file>
+    arg = tb_plus_match("pctrace=");
+    if ((arg) && (arg[0]) && (PC_TRACE)) tb_pctrace(top, arg + 9);
     top->final();
-    fclose(logger);
+    if (TB_TRACED(log_idx)) fclose(logger);
+    in_close();
+    bt_close();
+    bool tc_ok = tc_close();
+    z88_mem->sync();
+
+    if (cov_file)
+    {
+        cov_save(cov_file);
+        printf("\nCoverage : ROM %u code / %u data bytes, RAM %u code / %u data bytes\n",
+               cov_count(cov_code, 0x000000, 0x080000), cov_count(cov_data, 0x000000, 0x080000),
+               cov_count(cov_code, 0x080000, 0x100000), cov_count(cov_data, 0x080000, 0x100000));
+    }
+
+    // Performance counters : +perf=<file>
+    arg = tb_plus_match("perf=");
+    if ((arg) && (arg[0]))
+    {
+        static const char *names[PRB_PERF_NUM] =
+        {
+            "cycles", "t_states", "fetches", "halt_t_states", "lcd_cycles",
+            "bank_writes", "int_time", "int_key", "int_flap"
+        };
+        FILE *fh = fopen(arg + 6, "w");
+
+        if (fh)
+        {
+            for (int i = 0; i < PRB_PERF_NUM; i++)
+                fprintf(fh, "%s %u\n", names[i], (unsigned)PRB_PERF(prb, i));
+            fclose(fh);
+            printf("\nPerformance counters written to \"%s\"\n", arg + 6);
+        }
+    }
+
+    if (ROM_CACHE)
+    {
+        uint64_t hits = PRB_RC_HITS(prb);
+        uint64_t miss = PRB_RC_MISSES(prb);
+
+        printf("\nROM cache : %lu hits, %lu misses (%.1f %% hits)\n", (unsigned long)hits, (unsigned long)miss,
+               (hits + miss) ? 100.0 * hits / (hits + miss) : 0.0);
+    }
+
+    if (ATTR_CACHE) printf("\nLCD attribute cache : %u LCD bus cycles\n", (unsigned)PRB_PERF(prb, 4));
 
 #if VM_TRACE
     if (tfp) tfp->close();
@@ -517,6 +1120,15 @@ int main(int argc, char **argv, char **env)
     end = time(0);
     secs = difftime(end, beg);
     printf("\n\nSeconds elapsed : %f\n", secs);
+    job_report(log_idx - job_fr, tb_time - job_ps, secs);
+
+    // Time-parallel tracing : wait for the last segments
+    if ((tpar) && (job_self < 0))
+    {
+        while (job_wait() >= 0);
+        end = time(0);
+        job_summary(difftime(end, beg));
+    }
 
-    exit(0);
+    exit((tc_ok) ? 0 : -1);
 }
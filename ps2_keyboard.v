@@ -12,6 +12,8 @@ module ps2_keyboard
   // PS/2 keyboard port
   inout        ps2_kclk, // PS/2 keyboard clock (O.C.)
   inout        ps2_kdat, // PS/2 keyboard data (O.C.)
+  output       kclk_oe,  // KCLK driven low
+  output       kdat_oe,  // KDAT driven low
   // PS/2 keyboard data
   output       kb_vld,   // Keyboard data valid
   output [7:0] kb_data   // Keyboard data
@@ -28,6 +30,9 @@ assign w_kdat_out = r_tx_buf[0] | r_tx_led1 | r_tx_led2;
 assign ps2_kclk = (~r_kclk_out) ? 1'b0 : 1'bZ;
 assign ps2_kdat = (~w_kdat_out) ? 1'b0 : 1'bZ;
 
+assign kclk_oe  = ~r_kclk_out;
+assign kdat_oe  = ~w_kdat_out;
+
 ///////////////////////////
 // Clock domain crossing //
 ///////////////////////////
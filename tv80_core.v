@@ -25,7 +25,7 @@
 module tv80_core (/*AUTOARG*/
   // Outputs
   m1_n, iorq, no_read, write, rfsh_n, halt_n, busak_n, A, dout, mc,
-  ts, intcycle_n, IntE, stop,
+  ts, intcycle_n, IntE, stop, dbg_regs,
   // Inputs
   reset_n, clk, cen, wait_n, int_n, nmi_n, busrq_n, dinst, di
   );
@@ -66,6 +66,7 @@ module tv80_core (/*AUTOARG*/
   output        intcycle_n;     
   output        IntE;           
   output        stop;           
+  output [127:0] dbg_regs;      // IY, IX, HL, DE, BC, AF, SP, PC (debug)
 
   reg    m1_n;          
   reg    iorq; 
@@ -91,15 +92,15 @@ module tv80_core (/*AUTOARG*/
   parameter     aZI      = 3'b110;
 
   // Registers
-  reg [7:0]     ACC /* verilator public */;
-  reg [7:0]     F /* verilator public */;
+  reg [7:0]     ACC;
+  reg [7:0]     F;
   reg [7:0]     Ap, Fp;
   reg [7:0]     I;
 `ifdef TV80_REFRESH
   reg [7:0]     R;
 `endif
-  reg [15:0]    SP /* verilator public */;
-  reg [15:0]    PC /* verilator public */;
+  reg [15:0]    SP;
+  reg [15:0]    PC;
   reg [7:0]     RegDIH;
   reg [7:0]     RegDIL;
   wire [15:0]   RegBusA;
@@ -1031,9 +1032,13 @@ module tv80_core (/*AUTOARG*/
      .DOBH                 (RegBusB[15:8]),
      .DOBL                 (RegBusB[7:0]),
      .DOCH                 (RegBusC[15:8]),
-     .DOCL                 (RegBusC[7:0])
+     .DOCL                 (RegBusC[7:0]),
+     .dbg_regs             (dbg_regs[127:48]),
+     .dbg_alt              (Alternate)
      );
 
+  assign dbg_regs[47:0] = { ACC, F, SP, PC };
+
   //-------------------------------------------------------------------------
   //
   // Buses
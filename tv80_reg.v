@@ -24,9 +24,9 @@
 
 module tv80_reg (/*AUTOARG*/
   // Outputs
-  DOBH, DOAL, DOCL, DOBL, DOCH, DOAH, 
+  DOBH, DOAL, DOCL, DOBL, DOCH, DOAH, dbg_regs,
   // Inputs
-  AddrC, AddrA, AddrB, DIH, DIL, clk, CEN, WEH, WEL
+  AddrC, AddrA, AddrB, DIH, DIL, clk, CEN, WEH, WEL, dbg_alt
   );
     input  [2:0] AddrC;
     output [7:0] DOBH;
@@ -39,7 +39,9 @@ module tv80_reg (/*AUTOARG*/
     output [7:0] DOBL;
     output [7:0] DOCH;
     output [7:0] DOAH;
+    output [79:0] dbg_regs;  // IY, IX, HL, DE, BC (debug)
     input  clk, CEN, WEH, WEL;
+    input  dbg_alt;          // Alternate BC, DE, HL in use (EXX)
 
   reg [7:0] RegsH [0:7];
   reg [7:0] RegsL [0:7];
@@ -60,26 +62,13 @@ module tv80_reg (/*AUTOARG*/
   assign DOCH = RegsH[AddrC];
   assign DOCL = RegsL[AddrC];
 
-  // break out ram bits for waveform debug
-// synopsys translate_off
-  wire [7:0] B /* verilator public */;
-  assign B = RegsH[0];
-  wire [7:0] C /* verilator public */;
-  assign C = RegsL[0];
-  wire [7:0] D /* verilator public */;
-  assign D = RegsH[1];
-  wire [7:0] E /* verilator public */;
-  assign E = RegsL[1];
-  wire [7:0] H /* verilator public */;
-  assign H = RegsH[2];
-  wire [7:0] L /* verilator public */;
-  assign L = RegsL[2];
-
-  wire [15:0] IX /* verilator public */;
-  assign IX = { RegsH[3], RegsL[3] };
-  wire [15:0] IY /* verilator public */;
-  assign IY = { RegsH[7], RegsL[7] };
-// synopsys translate_on
+  // break out ram bits for debug (simulation probe, block move engine),
+  // BC, DE, HL of the set in use
+  assign dbg_regs = { RegsH[7], RegsL[7],                                     // IY
+                      RegsH[3], RegsL[3],                                     // IX
+                      RegsH[{ dbg_alt, 2'b10 }], RegsL[{ dbg_alt, 2'b10 }],   // HL
+                      RegsH[{ dbg_alt, 2'b01 }], RegsL[{ dbg_alt, 2'b01 }],   // DE
+                      RegsH[{ dbg_alt, 2'b00 }], RegsL[{ dbg_alt, 2'b00 }] }; // BC
   
 endmodule
 
@@ -24,7 +24,7 @@
 
 module tv80s (/*AUTOARG*/
   // Outputs
-  m1_n, mreq_n, iorq_n, rd_n, wr_n, rfsh_n, halt_n, busak_n, A, dout,
+  m1_n, mreq_n, iorq_n, rd_n, wr_n, rfsh_n, halt_n, busak_n, A, dout, dbg_regs,
   // Inputs
   reset_n, clk, wait_n, int_n, nmi_n, busrq_n, di, cen // GE
   );
@@ -51,6 +51,7 @@ module tv80s (/*AUTOARG*/
   output [15:0] A;
   input [7:0]   di;
   output [7:0]  dout;
+  output [127:0] dbg_regs; // IY, IX, HL, DE, BC, AF, SP, PC (debug)
   input         cen;
 
   reg           mreq_n;
@@ -93,7 +94,8 @@ module tv80s (/*AUTOARG*/
      .dout (dout),
      .mc (mcycle),
      .ts (tstate),
-     .intcycle_n (intcycle_n)
+     .intcycle_n (intcycle_n),
+     .dbg_regs (dbg_regs)
      );
 
   always @(posedge clk or negedge reset_n)
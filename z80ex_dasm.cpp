@@ -48,7 +48,7 @@ LIB_EXPORT int z80ex_dasm(char *output, int output_size, unsigned flags, int *t_
 	const char *bytes_format=formats[0];
 	const char *words_format=formats[1];
 	const z80ex_opc_dasm *dasm = NULL;
-	static char stmp[STMP_SIZE];
+	char stmp[STMP_SIZE]; /*on the stack : z80ex_dasm may run on several threads*/
 
 	if(flags & WORDS_DEC) words_format = formats[2];
 	if(flags & BYTES_DEC) bytes_format = formats[2];
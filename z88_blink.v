@@ -5,6 +5,7 @@ module z88_blink
     input           clk,          // Master clock (50 MHz)
     input           clk_ena,      // 12.5 MHz equivalent clock
     input           bus_ph,       // Bus phase (0 : LCD, 1 : Z80)
+    input           cpu_ph,       // Z80 owns the bus (bus_ph or lent LCD phase)
     
     // Z80 bus
     input           z80_io_rd,    // Z80 I/O read
@@ -13,30 +14,45 @@ module z88_blink
     input     [7:0] z80_wdata,    // Z80 data bus (write)
     output    [7:0] z80_rdata,    // Z80 data bus (read)
     input           z80_hlt_n,    // HALT Coma / Standby command
+    input           z80_cen,      // Z80 clock enable (performance counters)
+    input           z80_m1_n,     // Z80 opcode fetch (performance counters)
+    input           z80_mreq_n,   // Z80 memory request (performance counters)
     output          z80_int_n,    // Maskable interrupt
     output          z80_nmi_n,    // Non maskable interrupt
     
     output   [21:0] cpu_addr,     // 4 MB address space
     
     output          lcd_on,       // LCD is ON
+    input           lcd_rden,     // LCD bus cycle (performance counters)
     
     output          stby,         // Standby mode
     
     input    [63:0] kb_matrix,    // 64-key keyboard matrix
     output    [7:0] kbd_val,      // KBD register value (debug)
+    output   [39:0] mmu_regs,     // COM, SR3 - SR0 (debug)
+    output  [287:0] perf_cnt,     // Performance counters 8 - 0 (debug)
+    output          bmv_ena,      // Block move engine enabled (ACTL bit 0)
     
     input           flap_sw       // Flap switch
 );
 
+    // Simulation : the RTC runs RTC_SCALE times faster (1 : real time),
+    // set by the compile script (a macro keeps the Verilator class names)
+`ifdef Z88_RTC_SCALE
+    parameter RTC_SCALE = `Z88_RTC_SCALE;
+`else
+    parameter RTC_SCALE = 1;
+`endif
+
     // ========================================================================
     // MMU Registers Write
     // ========================================================================
     
     // Bank switching (write only)
-    reg  [7:0] r_SR0 /* verilator public */;
-    reg  [7:0] r_SR1 /* verilator public */;
-    reg  [7:0] r_SR2 /* verilator public */;
-    reg  [7:0] r_SR3 /* verilator public */;
+    reg  [7:0] r_SR0;
+    reg  [7:0] r_SR1;
+    reg  [7:0] r_SR2;
+    reg  [7:0] r_SR3;
 
     // Segment Registers Write
     always @(posedge rst or posedge clk) begin : MMU_REGS_WR
@@ -65,6 +81,17 @@ module z88_blink
     // Real time clock
     // ========================================================================
     
+    localparam [14:0] RTC_DIV = 31250 / RTC_SCALE;
+    
+    // The 5 ms period must stay exact : RTC_SCALE divides 31250
+    // (1, 2, 5, 10, 25, 50, 125, 250, 625, 1250, 3125, 6250, 15625, 31250)
+`ifdef Z88_RTC_SCALE
+    initial begin
+        if ((RTC_SCALE < 1) || (RTC_SCALE > 31250) || (31250 % RTC_SCALE != 0))
+            $error("RTC_SCALE = %0d does not divide 31250", RTC_SCALE);
+    end
+`endif
+    
     reg [14:0] r_div_5ms; // 6.25 MHz to 200 Hz divider
     reg  [7:0] r_TIM0;    // 5ms tick counter (0-199)
     reg  [5:0] r_TIM1;    // Seconds counter (0-59)
@@ -146,7 +173,7 @@ module z88_blink
             r_rtc_irq[2] <= v_tick_5ms & v_tick_1sec & v_tick_1min;
             
             // Comparators
-            v_tick_5ms   <= (r_div_5ms == 15'd31250) ? 1'b1 : 1'b0;
+            v_tick_5ms   <= (r_div_5ms == RTC_DIV) ? 1'b1 : 1'b0;
             v_tick_640ms <= (r_TIM0 == 8'd127) ? 1'b1 : 1'b0;
             v_tick_1sec  <= (r_TIM0 == 8'd199) ? 1'b1 : 1'b0;
             v_tick_1min  <= (r_TIM1 == 6'd59) ? 1'b1 : 1'b0;
@@ -160,7 +187,7 @@ module z88_blink
     // ========================================================================
     
     // Common control register (I/O address $B0)
-    reg  [7:0] r_COM /* verilator public */;
+    reg  [7:0] r_COM;
     // Interrupt masking register (I/O address $B1)
     reg  [7:0] r_INT;
     // Interrupt acknowledge register (I/O address $B6)
@@ -284,8 +311,9 @@ module z88_blink
             r_z80_rdata <= 8'h00;
         end
         else begin
-            // I/O Registers Read
-            if (clk_ena & bus_ph) begin
+            // I/O Registers Read, at the end of each Z80 window (lent LCD
+            // windows too : a read latched there may end with the next one)
+            if (clk_ena & cpu_ph) begin
                 if (z80_io_rd) begin
                     case(z80_addr[7:0])
                         // STA : interrupt status
@@ -306,6 +334,15 @@ module z88_blink
                         8'hD4 : r_z80_rdata <= { 3'b0, r_TIM4 };
                         // UIT : UART interrupt status (required but not implemented)
                         8'hE5 : r_z80_rdata <= 8'h00;
+                        // PSEL : performance counter select
+                        8'hF0 : r_z80_rdata <= { 4'b0, r_PSEL };
+                        // PCNT : selected performance counter
+                        8'hF1 : r_z80_rdata <= r_PCNT[ 7: 0];
+                        8'hF2 : r_z80_rdata <= r_PCNT[15: 8];
+                        8'hF3 : r_z80_rdata <= r_PCNT[23:16];
+                        8'hF4 : r_z80_rdata <= r_PCNT[31:24];
+                        // ACTL : accelerator control
+                        8'hF5 : r_z80_rdata <= { 7'b0, r_ACTL };
                         // Unknown
                         default: r_z80_rdata <= 8'h00;
                     endcase
@@ -357,7 +394,7 @@ module z88_blink
     always @(*) begin : CPU_ADDR_GEN
     
         // Address translation
-        if (bus_ph) begin
+        if (cpu_ph) begin
             casez (z80_addr[15:13])
                 // 0000-1FFF : Bank $00 !RAMS, Bank $20 RAMS
                 3'b000 : r_cpu_addr = { 2'b00, r_COM[2], 6'b0, z80_addr[12:0] };
@@ -414,4 +451,95 @@ module z88_blink
     
     assign kbd_val = r_kbd_val;
     
+    assign mmu_regs = { r_COM, r_SR3, r_SR2, r_SR1, r_SR0 };
+    
+    // ========================================================================
+    // Performance counters
+    // ========================================================================
+    
+    // 32-bit event counters :
+    // 0 : 6.25 MHz cycles           5 : SR0 - SR3 writes (bank switching)
+    // 1 : Z80 T-states              6 : TIME interrupts (STA bit 0 rising)
+    // 2 : Z80 opcode fetches        7 : KEY interrupts (STA bit 2 rising)
+    // 3 : Z80 T-states in HALT      8 : FLAP interrupts (STA bit 5 rising)
+    // 4 : LCD bus cycles
+    // Writing PSEL ($F0) latches the counter selected by bits 3-0 into PCNT
+    // ($F1 : LSB - $F4 : MSB), with bit 7 set all the counters are cleared.
+    
+    reg  [3:0] r_PSEL;         // Counter select (I/O address $F0)
+    reg [31:0] r_PCNT;         // Selected counter (I/O addresses $F1 - $F4)
+    reg [31:0] r_perf [0:8];   // Counters
+    reg  [7:0] r_perf_sta;     // Previous interrupt status
+    reg        r_perf_iow;     // Previous I/O write (one count per access)
+    wire [8:0] w_perf_evt;     // Events
+    
+    assign w_perf_evt[0] = clk_ena & bus_ph;
+    assign w_perf_evt[1] = z80_cen;
+    assign w_perf_evt[2] = z80_cen & ~z80_m1_n & ~z80_mreq_n;
+    assign w_perf_evt[3] = z80_cen & ~z80_hlt_n;
+    assign w_perf_evt[4] = clk_ena & ~bus_ph & lcd_rden;
+    assign w_perf_evt[5] = z80_io_wr & ~r_perf_iow & (z80_addr[7:2] == 6'b110100);
+    assign w_perf_evt[6] = r_STA[0] & ~r_perf_sta[0];
+    assign w_perf_evt[7] = r_STA[2] & ~r_perf_sta[2];
+    assign w_perf_evt[8] = r_STA[5] & ~r_perf_sta[5];
+    
+    always @(posedge rst or posedge clk) begin : PERF_CNT
+        integer v_idx;
+        
+        if (rst) begin
+            for (v_idx = 0; v_idx < 9; v_idx = v_idx + 1) begin
+                r_perf[v_idx] <= 32'd0;
+            end
+            r_PSEL     <= 4'd0;
+            r_PCNT     <= 32'd0;
+            r_perf_sta <= 8'h00;
+            r_perf_iow <= 1'b0;
+        end
+        else begin
+            // Count the events
+            for (v_idx = 0; v_idx < 9; v_idx = v_idx + 1) begin
+                if (w_perf_evt[v_idx]) r_perf[v_idx] <= r_perf[v_idx] + 32'd1;
+            end
+            // I/O Register Write
+            if (z80_io_wr & clk_ena & bus_ph & (z80_addr[7:0] == 8'hF0)) begin
+                r_PSEL <= z80_wdata[3:0];
+                r_PCNT <= (z80_wdata[3:0] < 4'd9) ? r_perf[z80_wdata[3:0]] : 32'd0;
+                if (z80_wdata[7]) begin
+                    for (v_idx = 0; v_idx < 9; v_idx = v_idx + 1) begin
+                        r_perf[v_idx] <= 32'd0;
+                    end
+                end
+            end
+            r_perf_sta <= r_STA;
+            r_perf_iow <= z80_io_wr;
+        end
+    end
+    
+    assign perf_cnt = { r_perf[8], r_perf[7], r_perf[6], r_perf[5], r_perf[4],
+                        r_perf[3], r_perf[2], r_perf[1], r_perf[0] };
+    
+    // ========================================================================
+    // Accelerator control
+    // ========================================================================
+    
+    // ACTL ($F5) bit 0 enables the LDIR / LDDR block move engine of z88_top
+    // (BLOCK_MOVE build), cleared after reset : cycle accurate block moves.
+    
+    reg        r_ACTL;         // Accelerator control (I/O address $F5)
+    
+    always @(posedge rst or posedge clk) begin : ACCEL_CTRL
+    
+        if (rst) begin
+            r_ACTL <= 1'b0;
+        end
+        else begin
+            // I/O Register Write
+            if (z80_io_wr & clk_ena & bus_ph & (z80_addr[7:0] == 8'hF5)) begin
+                r_ACTL <= z80_wdata[0];
+            end
+        end
+    end
+    
+    assign bmv_ena = r_ACTL;
+    
 endmodule
\ No newline at end of file
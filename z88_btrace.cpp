@@ -0,0 +1,148 @@
+// Bus tracer : Z80 accesses recorded into a ring buffer (DPI)
+
+#include "z88_btrace.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+static std::vector<BtRecord> bt_ring;
+static uint64_t bt_count;       // Records pushed (the ring keeps the last ones)
+static uint64_t bt_cur;         // Current step
+static char     bt_file[256];
+static unsigned bt_typ;         // Types enabled, 0 : not tracing
+static bool     bt_phy;         // Range on physical addresses
+static unsigned bt_lo;
+static unsigned bt_hi;
+
+bool bt_open(const char *file_name, unsigned size)
+{
+    bt_ring.clear();
+    bt_count = 0;
+    bt_typ   = 0;
+    if (file_name == NULL) return true;
+
+    if (size == 0) size = 1;
+    bt_ring.resize(size);
+    strncpy(bt_file, file_name, sizeof(bt_file) - 1);
+    bt_file[sizeof(bt_file) - 1] = '\0';
+    bt_typ = BT_ALL;
+    bt_phy = false;
+    bt_lo  = 0;
+    bt_hi  = 0xFFFF;
+    printf("Bus trace into \"%s\" (last %u accesses).\n", file_name, size);
+    return true;
+}
+
+bool bt_filter(const char *types, const char *range)
+{
+    if (!bt_typ) return true;
+
+    if (types)
+    {
+        static const char letters[] = "rwiof";
+
+        bt_typ = 0;
+        for (const char *t = types; *t; t++)
+        {
+            const char *l = strchr(letters, *t);
+
+            if (l == NULL)
+            {
+                printf("Unknown bus trace type '%c'.\n", *t);
+                return false;
+            }
+            bt_typ |= 1 << (l - letters);
+        }
+    }
+    if (range)
+    {
+        char *end;
+
+        bt_phy = (range[0] == 'p');
+        if (bt_phy) range++;
+        bt_lo = strtoul(range, &end, 16);
+        if (*end != '-')
+        {
+            printf("Bad bus trace range \"%s\".\n", range);
+            return false;
+        }
+        bt_hi = strtoul(end + 1, NULL, 16);
+    }
+    return true;
+}
+
+unsigned bt_types(void)
+{
+    return bt_typ;
+}
+
+void bt_step(uint64_t step)
+{
+    bt_cur = step;
+}
+
+void z88_bus_trace(int typ, int addr, int phy, int data)
+{
+    unsigned a = (bt_phy) ? (unsigned)phy : (unsigned)addr;
+    BtRecord *rec;
+
+    if (!(bt_typ & typ)) return;
+    // I/O ports have no physical address
+    if (bt_phy && (typ & (BT_IO_RD | BT_IO_WR))) return;
+    if ((a < bt_lo) || (a > bt_hi)) return;
+
+    rec = &bt_ring[bt_count++ % bt_ring.size()];
+    rec->step = bt_cur;
+    rec->phy  = phy;
+    rec->addr = addr;
+    rec->type = typ;
+    rec->data = data;
+}
+
+void bt_close(void)
+{
+    static const char *names[] = { "MRD", "MWR", "IRD", "IWR", "M1" };
+    size_t   size = bt_ring.size();
+    uint64_t num  = (bt_count < size) ? bt_count : size;
+    size_t   len  = strlen(bt_file);
+    bool     text = (len > 4) && !strcmp(bt_file + len - 4, ".txt");
+    FILE    *fh;
+
+    if (!bt_typ) return;
+    bt_typ = 0;
+
+    fh = fopen(bt_file, (text) ? "w" : "wb");
+    if (fh == NULL)
+    {
+        printf("Cannot create bus trace \"%s\".\n", bt_file);
+        return;
+    }
+    if (!text)
+    {
+        fwrite("Z88BTRC1", 1, 8, fh);
+        fwrite(&num, sizeof(num), 1, fh);
+    }
+    // Oldest record first
+    for (uint64_t i = bt_count - num; i < bt_count; i++)
+    {
+        const BtRecord &rec = bt_ring[i % size];
+
+        if (text)
+        {
+            int t = 0;
+
+            while ((t < 4) && !(rec.type & (1 << t))) t++;
+            fprintf(fh, "%lu %-3s %04X %06X %02X\n", (unsigned long)rec.step, names[t],
+                    rec.addr, rec.phy, rec.data);
+        }
+        else
+        {
+            fwrite(&rec, sizeof(rec), 1, fh);
+        }
+    }
+    fclose(fh);
+    printf("Bus trace : %lu accesses written (%lu traced).\n", (unsigned long)num, (unsigned long)bt_count);
+    bt_ring.clear();
+}
@@ -0,0 +1,54 @@
+// Bus tracer : Z80 accesses recorded into a ring buffer (DPI)
+//
+// z88_top.v passes every access of the enabled types to z88_bus_trace(), the
+// records matching the address range are kept in a ring buffer (the last
+// ones are kept) written at the end of the run. No file access is done
+// during the run.
+//
+// Binary file : "Z88BTRC1" header, record count (uint64_t), then the records
+// (BtRecord, little endian), oldest first. A ".txt" file name gives text
+// lines instead : <step> <type> <logical addr> <physical addr> <data>.
+
+#ifndef _Z88_BTRACE_H_INCLUDED
+#define _Z88_BTRACE_H_INCLUDED
+
+#include <stdint.h>
+
+// Access types (BTRACE input bits)
+#define BT_MEM_RD  0x01
+#define BT_MEM_WR  0x02
+#define BT_IO_RD   0x04
+#define BT_IO_WR   0x08
+#define BT_FETCH   0x10
+#define BT_ALL     0x1F
+
+struct BtRecord
+{
+    uint64_t step;  // Simulation step
+    uint32_t phy;   // Physical address (memory accesses)
+    uint16_t addr;  // Logical address / I/O port
+    uint8_t  type;  // BT_xxx
+    uint8_t  data;
+};
+
+// Start tracing into a file, "size" records kept (NULL : stop, nothing written)
+extern bool bt_open(const char *file_name, unsigned size);
+
+// Types : letters r (memory read), w (memory write), i (I/O read),
+// o (I/O write), f (opcode fetch), range : "XXXX-YYYY" (logical addresses
+// and I/O ports) or "pXXXXXX-YYYYYY" (physical addresses), NULL : all
+extern bool bt_filter(const char *types, const char *range);
+
+// Types enabled (BTRACE input value), 0 when not tracing
+extern unsigned bt_types(void);
+
+// Current simulation step
+extern void bt_step(uint64_t step);
+
+// Write the records and close the file
+extern void bt_close(void);
+
+// DPI (import "DPI-C" function void z88_bus_trace(...))
+extern "C" void z88_bus_trace(int typ, int addr, int phy, int data);
+
+#endif
@@ -0,0 +1,63 @@
+// Code / data coverage over the 4 MB physical address space
+//
+// Dump file : raw code bitmap (512 KB) followed by raw data bitmap (512 KB),
+// bit N of byte B covers physical address B*8+N. Dumps of several runs are
+// merged with a bitwise OR.
+
+#include "z88_cov.h"
+
+#include <cstdio>
+
+unsigned char cov_code[COV_SIZE >> 3];
+unsigned char cov_data[COV_SIZE >> 3];
+
+static bool cov_merge(FILE *fh, unsigned char *bmp)
+{
+    static unsigned char buf[COV_SIZE >> 3];
+    size_t len = fread(buf, 1, sizeof(buf), fh);
+
+    for (size_t i = 0; i < len; i++)
+    {
+        bmp[i] |= buf[i];
+    }
+    return len == sizeof(buf);
+}
+
+bool cov_load(const char *file_name)
+{
+    FILE *fh = fopen(file_name, "rb");
+    bool ok;
+
+    if (fh == NULL) return false;
+    ok = cov_merge(fh, cov_code) && cov_merge(fh, cov_data);
+    fclose(fh);
+    printf("Merged coverage from \"%s\".\n", file_name);
+    return ok;
+}
+
+bool cov_save(const char *file_name)
+{
+    FILE *fh = fopen(file_name, "wb");
+    bool ok;
+
+    if (fh == NULL)
+    {
+        printf("Cannot open coverage file \"%s\" for writing.\n", file_name);
+        return false;
+    }
+    ok = (fwrite(cov_code, 1, sizeof(cov_code), fh) == sizeof(cov_code))
+      && (fwrite(cov_data, 1, sizeof(cov_data), fh) == sizeof(cov_data));
+    fclose(fh);
+    return ok;
+}
+
+unsigned cov_count(const unsigned char *bmp, unsigned beg, unsigned end)
+{
+    unsigned num = 0;
+
+    for (unsigned i = beg >> 3; i < (end >> 3); i++)
+    {
+        num += __builtin_popcount(bmp[i]);
+    }
+    return num;
+}
@@ -0,0 +1,26 @@
+// Code / data coverage over the 4 MB physical address space
+
+#ifndef _Z88_COV_H_INCLUDED
+#define _Z88_COV_H_INCLUDED
+
+#define COV_SIZE      (1<<22)
+
+// One bit per physical byte
+extern unsigned char cov_code[COV_SIZE >> 3]; // Opcode fetches (M1)
+extern unsigned char cov_data[COV_SIZE >> 3]; // Memory reads and writes
+
+static inline void cov_mark(unsigned char *bmp, unsigned phy)
+{
+    bmp[(phy >> 3) & ((COV_SIZE >> 3) - 1)] |= 1 << (phy & 7);
+}
+
+// Merge a previous dump into the bitmaps (missing file is not an error)
+extern bool cov_load(const char *file_name);
+
+// Dump the bitmaps (code, then data)
+extern bool cov_save(const char *file_name);
+
+// Number of bits set in [beg, end[
+extern unsigned cov_count(const unsigned char *bmp, unsigned beg, unsigned end);
+
+#endif
@@ -20,6 +20,19 @@ module z88_de1_top
     
     inout         PS2_CLK,
     inout         PS2_DAT,
+    `ifdef verilator3
+    output        PS2_CLK_OE,
+    output        PS2_DAT_OE,
+    input  [63:0] KB_INJ,
+    input  [63:0] CPU_INJ,
+    input   [3:0] CPU_INJ_LEN,
+    input         CPU_INJ_TGL,
+    input         RC_CLR_TGL,
+    output [607:0] DBG_PROBE,
+    input   [4:0] BTRACE,
+    input  [15:0] PCT_IDX,
+    output [23:0] PCT_DAT,
+    `endif
     
     output  [3:0] VGA_R,
     output  [3:0] VGA_G,
@@ -61,6 +74,7 @@ module z88_de1_top
     reg  [6:0] r_flap_n;
     reg        r_rst;
     reg        r_flap;
+    wire       w_pct_trig; // PC trace trigger (debounced SW[9])
     wire       w_clk_ena;
     wire       w_bus_ph;
 
@@ -75,6 +89,7 @@ module z88_de1_top
     // Z88 instance
     // ========================================================================
     
+    wire [63:0] w_kb_matrix;
     wire  [7:0] w_kbd_val;
     
     wire        w_ram_ce_n;
@@ -114,8 +129,9 @@ module z88_de1_top
         .clk_ena    (w_clk_ena),
         .bus_ph     (w_bus_ph),
         .flap_sw    (r_flap),
+        .pct_trig   (w_pct_trig),
         
-        .kb_matrix  (r_kb_matrix_p2),
+        .kb_matrix  (w_kb_matrix),
         .kbd_val    (w_kbd_val),
         
         .ram_ce_n   (w_ram_ce_n),
@@ -132,6 +148,17 @@ module z88_de1_top
         .rom_addr   (w_rom_addr),
         .rom_rdata  (w_rom_rdata),
         
+        `ifdef verilator3
+        .cpu_inj     (CPU_INJ),
+        .cpu_inj_len (CPU_INJ_LEN),
+        .cpu_inj_tgl (CPU_INJ_TGL),
+        .rc_clr_tgl  (RC_CLR_TGL),
+        .dbg_probe   (DBG_PROBE),
+        .btrace      (BTRACE),
+        .pct_idx     (PCT_IDX),
+        .pct_dat     (PCT_DAT),
+        
+        `endif
         .vga_fr_tgl (w_vga_fr_tgl),
         .vga_hs     (w_vga_hs),
         .vga_vs     (w_vga_vs),
@@ -196,6 +223,13 @@ module z88_de1_top
         .disk_led  (1'b0),
         .ps2_kclk  (PS2_CLK),
         .ps2_kdat  (PS2_DAT),
+        `ifdef verilator3
+        .kclk_oe   (PS2_CLK_OE),
+        .kdat_oe   (PS2_DAT_OE),
+        `else
+        .kclk_oe   (),
+        .kdat_oe   (),
+        `endif
         .kb_vld    (w_kb_vld_p0),
         .kb_data   (w_kb_data_p0)
     );
@@ -246,97 +280,11 @@ module z88_de1_top
     reg  [63:0] r_kb_matrix_p2;
     
     always@(posedge r_rst or posedge CLOCK_50) begin : KB_MATRIX_P2
-        `ifdef verilator3
-        integer v_fr_num;
-        reg     v_fr_tgl;
-        `endif
     
         if (r_rst) begin
-            `ifdef verilator3
-            v_fr_num  = 0;
-            v_fr_tgl <= 1'b0;
-            `endif
             r_kb_matrix_p2 <= 64'b0;
         end
         else begin
-            `ifdef verilator3
-            if (v_fr_tgl != w_vga_fr_tgl) begin
-                if (v_fr_num == 32'd150) r_kb_matrix_p2[22] <= 1'b1; // Down
-                if (v_fr_num == 32'd151) r_kb_matrix_p2[22] <= 1'b0;
-                if (v_fr_num == 32'd155) r_kb_matrix_p2[22] <= 1'b1; // Down
-                if (v_fr_num == 32'd156) r_kb_matrix_p2[22] <= 1'b0;
-                if (v_fr_num == 32'd160) r_kb_matrix_p2[ 6] <= 1'b1; // Enter
-                if (v_fr_num == 32'd161) r_kb_matrix_p2[ 6] <= 1'b0;
-                if (v_fr_num == 32'd192) r_kb_matrix_p2[45] <= 1'b1; // 1
-                if (v_fr_num == 32'd193) r_kb_matrix_p2[45] <= 1'b0;
-                if (v_fr_num == 32'd196) r_kb_matrix_p2[40] <= 1'b1; // 0
-                if (v_fr_num == 32'd197) r_kb_matrix_p2[40] <= 1'b0;
-                if (v_fr_num == 32'd200) r_kb_matrix_p2[46] <= 1'b1; // Space
-                if (v_fr_num == 32'd201) r_kb_matrix_p2[46] <= 1'b0;
-                if (v_fr_num == 32'd204) r_kb_matrix_p2[32] <= 1'b1; // P
-                if (v_fr_num == 32'd205) r_kb_matrix_p2[32] <= 1'b0;
-                if (v_fr_num == 32'd208) r_kb_matrix_p2[20] <= 1'b1; // R
-                if (v_fr_num == 32'd209) r_kb_matrix_p2[20] <= 1'b0;
-                if (v_fr_num == 32'd212) r_kb_matrix_p2[ 8] <= 1'b1; // I
-                if (v_fr_num == 32'd213) r_kb_matrix_p2[ 8] <= 1'b0;
-                if (v_fr_num == 32'd216) r_kb_matrix_p2[ 2] <= 1'b1; // N
-                if (v_fr_num == 32'd217) r_kb_matrix_p2[ 2] <= 1'b0;
-                if (v_fr_num == 32'd220) r_kb_matrix_p2[12] <= 1'b1; // T
-                if (v_fr_num == 32'd221) r_kb_matrix_p2[12] <= 1'b0;
-                if (v_fr_num == 32'd224) r_kb_matrix_p2[46] <= 1'b1; // Space
-                if (v_fr_num == 32'd225) r_kb_matrix_p2[46] <= 1'b0;
-                if (v_fr_num == 32'd228) r_kb_matrix_p2[54] <= 1'b1; // Shift
-                if (v_fr_num == 32'd228) r_kb_matrix_p2[48] <= 1'b1; // "
-                if (v_fr_num == 32'd229) r_kb_matrix_p2[54] <= 1'b0;
-                if (v_fr_num == 32'd229) r_kb_matrix_p2[48] <= 1'b0;
-                if (v_fr_num == 32'd232) r_kb_matrix_p2[12] <= 1'b1; // T
-                if (v_fr_num == 32'd233) r_kb_matrix_p2[12] <= 1'b0;
-                if (v_fr_num == 32'd236) r_kb_matrix_p2[28] <= 1'b1; // E
-                if (v_fr_num == 32'd237) r_kb_matrix_p2[28] <= 1'b0;
-                if (v_fr_num == 32'd240) r_kb_matrix_p2[35] <= 1'b1; // S
-                if (v_fr_num == 32'd241) r_kb_matrix_p2[35] <= 1'b0;
-                if (v_fr_num == 32'd244) r_kb_matrix_p2[12] <= 1'b1; // T
-                if (v_fr_num == 32'd245) r_kb_matrix_p2[12] <= 1'b0;
-                if (v_fr_num == 32'd248) r_kb_matrix_p2[54] <= 1'b1; // Shift
-                if (v_fr_num == 32'd248) r_kb_matrix_p2[48] <= 1'b1; // "
-                if (v_fr_num == 32'd249) r_kb_matrix_p2[54] <= 1'b0;
-                if (v_fr_num == 32'd249) r_kb_matrix_p2[48] <= 1'b0;
-                if (v_fr_num == 32'd252) r_kb_matrix_p2[ 6] <= 1'b1; // Enter
-                if (v_fr_num == 32'd253) r_kb_matrix_p2[ 6] <= 1'b0;
-                if (v_fr_num == 32'd256) r_kb_matrix_p2[37] <= 1'b1; // 2
-                if (v_fr_num == 32'd257) r_kb_matrix_p2[37] <= 1'b0;
-                if (v_fr_num == 32'd260) r_kb_matrix_p2[40] <= 1'b1; // 0
-                if (v_fr_num == 32'd261) r_kb_matrix_p2[40] <= 1'b0;
-                if (v_fr_num == 32'd264) r_kb_matrix_p2[46] <= 1'b1; // Space
-                if (v_fr_num == 32'd265) r_kb_matrix_p2[46] <= 1'b0;
-                if (v_fr_num == 32'd268) r_kb_matrix_p2[11] <= 1'b1; // G
-                if (v_fr_num == 32'd269) r_kb_matrix_p2[11] <= 1'b0;
-                if (v_fr_num == 32'd272) r_kb_matrix_p2[16] <= 1'b1; // O
-                if (v_fr_num == 32'd273) r_kb_matrix_p2[16] <= 1'b0;
-                if (v_fr_num == 32'd276) r_kb_matrix_p2[12] <= 1'b1; // T
-                if (v_fr_num == 32'd277) r_kb_matrix_p2[12] <= 1'b0;
-                if (v_fr_num == 32'd280) r_kb_matrix_p2[16] <= 1'b1; // O
-                if (v_fr_num == 32'd281) r_kb_matrix_p2[16] <= 1'b0;
-                if (v_fr_num == 32'd284) r_kb_matrix_p2[46] <= 1'b1; // Space
-                if (v_fr_num == 32'd285) r_kb_matrix_p2[46] <= 1'b0;
-                if (v_fr_num == 32'd288) r_kb_matrix_p2[45] <= 1'b1; // 1
-                if (v_fr_num == 32'd289) r_kb_matrix_p2[45] <= 1'b0;
-                if (v_fr_num == 32'd292) r_kb_matrix_p2[40] <= 1'b1; // 0
-                if (v_fr_num == 32'd293) r_kb_matrix_p2[40] <= 1'b0;
-                if (v_fr_num == 32'd296) r_kb_matrix_p2[ 6] <= 1'b1; // Enter
-                if (v_fr_num == 32'd297) r_kb_matrix_p2[ 6] <= 1'b0;
-                if (v_fr_num == 32'd300) r_kb_matrix_p2[20] <= 1'b1; // R
-                if (v_fr_num == 32'd301) r_kb_matrix_p2[20] <= 1'b0;
-                if (v_fr_num == 32'd304) r_kb_matrix_p2[ 9] <= 1'b1; // U
-                if (v_fr_num == 32'd305) r_kb_matrix_p2[ 9] <= 1'b0;
-                if (v_fr_num == 32'd308) r_kb_matrix_p2[ 2] <= 1'b1; // N
-                if (v_fr_num == 32'd309) r_kb_matrix_p2[ 2] <= 1'b0;
-                if (v_fr_num == 32'd312) r_kb_matrix_p2[ 6] <= 1'b1; // Enter
-                if (v_fr_num == 32'd313) r_kb_matrix_p2[ 6] <= 1'b0;
-                v_fr_num = v_fr_num + 1;
-            end
-            v_fr_tgl <= w_vga_fr_tgl;
-            `else
             if (r_kb_vld_p1) begin
                 case (r_kb_data_p1[7:0])
                     //  A8 column
@@ -416,10 +364,16 @@ module z88_de1_top
                     default: ;                    
                 endcase
             end
-            `endif
         end
     end
     
+    `ifdef verilator3
+    // Simulation : keys injected by the testbench
+    assign w_kb_matrix = r_kb_matrix_p2 | KB_INJ;
+    `else
+    assign w_kb_matrix = r_kb_matrix_p2;
+    `endif
+    
     // ========================================================================
     // Debug
     // ========================================================================
@@ -524,6 +478,8 @@ module z88_de1_top
     
     reg [9:0] r_sw_cc [0:6];
     reg [9:0] r_sw_val;
+    reg [3:0] r_sw_rdy;  // De-bouncing settled after reset
+    reg       r_pct_arm; // SW[9] seen down : PC trace trigger armed
     
     always@(posedge r_rst or posedge CLOCK_50) begin : SWITCH_CC
         integer i;
@@ -538,6 +494,8 @@ module z88_de1_top
             r_sw_cc[5] <= 10'b0000000000;
             r_sw_cc[6] <= 10'b0000000000;
             r_sw_val   <= 10'b0000000000;
+            r_sw_rdy   <= 4'd0;
+            r_pct_arm  <= 1'b0;
         end
         else begin
             for (i = 0; i < 10; i = i + 1) begin
@@ -558,9 +516,17 @@ module z88_de1_top
             r_sw_cc[2] <= r_sw_cc[1];
             r_sw_cc[1] <= r_sw_cc[0];
             r_sw_cc[0] <= SW[9:0];
+            // A switch left up at reset does not trigger the PC trace
+            if (r_sw_rdy != 4'd15)
+                r_sw_rdy <= r_sw_rdy + 4'd1;
+            else if (!r_sw_val[9])
+                r_pct_arm <= 1'b1;
         end
     end
     
+    // Rising edge detected by z88_top
+    assign w_pct_trig = r_sw_val[9] & r_pct_arm;
+    
     assign LEDR = { r_rst, r_flap, r_sw_val[7:0] };
     assign LEDG = r_kb_matrix_p2[ 7: 0] & {8{r_sw_val[0]}}
                 | r_kb_matrix_p2[15: 8] & {8{r_sw_val[1]}}
@@ -0,0 +1,121 @@
+// Testbench inputs : recording and replay
+
+#include "z88_input.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+struct InEvent
+{
+    uint64_t step;
+    int      port;
+    uint64_t value;
+};
+
+static const char *in_name[IN_NUM_PORTS] = { "KEY", "SW", "PS2_CLK", "PS2_DAT", "KB" };
+
+static uint64_t in_val[IN_NUM_PORTS];   // Applied values
+static uint64_t in_cur;                 // Current step
+static FILE    *in_rec;                 // Recorded log
+static bool     in_replay;              // Live inputs ignored
+static std::vector<InEvent> in_evt;     // Replayed log
+static size_t   in_pos;                 // Next replayed event
+
+static void in_apply(int port, uint64_t value)
+{
+    if (in_val[port] == value) return;
+
+    in_val[port] = value;
+    if (in_rec)
+    {
+        fprintf(in_rec, "%lu %s %lX\n", (unsigned long)in_cur, in_name[port], (unsigned long)value);
+    }
+}
+
+bool in_record(const char *file_name)
+{
+    // Inherited (forked process) or previous log
+    if (in_rec) fclose(in_rec);
+    in_rec = NULL;
+    if (file_name == NULL) return true;
+
+    in_rec = fopen(file_name, "w");
+    if (in_rec == NULL)
+    {
+        printf("Cannot create input log \"%s\".\n", file_name);
+        return false;
+    }
+    fprintf(in_rec, "# Z88 input log : <step> <port> <hex value>\n");
+    // Initial values
+    for (int i = 0; i < IN_NUM_PORTS; i++)
+    {
+        fprintf(in_rec, "%lu %s %lX\n", (unsigned long)in_cur, in_name[i], (unsigned long)in_val[i]);
+    }
+    return true;
+}
+
+bool in_play(const char *file_name)
+{
+    FILE *fh = fopen(file_name, "r");
+    char line[256];
+
+    if (fh == NULL)
+    {
+        printf("Cannot open input log \"%s\".\n", file_name);
+        return false;
+    }
+    while (fgets(line, sizeof(line), fh))
+    {
+        unsigned long step, value;
+        char port[16];
+        InEvent evt;
+
+        if (strchr(line, '#')) *strchr(line, '#') = '\0';
+        if (sscanf(line, "%lu %15s %lx", &step, port, &value) != 3) continue;
+
+        for (evt.port = 0; evt.port < IN_NUM_PORTS; evt.port++)
+        {
+            if (!strcmp(port, in_name[evt.port])) break;
+        }
+        if (evt.port == IN_NUM_PORTS)
+        {
+            printf("Unknown input port \"%s\" in \"%s\".\n", port, file_name);
+            continue;
+        }
+        evt.step  = step;
+        evt.value = value;
+        in_evt.push_back(evt);
+    }
+    fclose(fh);
+    in_replay = true;
+    in_pos    = 0;
+    printf("Replaying %lu input events from \"%s\".\n", in_evt.size(), file_name);
+    return true;
+}
+
+void in_step(uint64_t step)
+{
+    in_cur = step;
+    while ((in_pos < in_evt.size()) && (in_evt[in_pos].step <= step))
+    {
+        in_apply(in_evt[in_pos].port, in_evt[in_pos].value);
+        in_pos++;
+    }
+}
+
+void in_set(int port, uint64_t value)
+{
+    if (!in_replay) in_apply(port, value);
+}
+
+uint64_t in_get(int port)
+{
+    return in_val[port];
+}
+
+void in_close(void)
+{
+    in_record(NULL);
+}
@@ -0,0 +1,41 @@
+// Testbench inputs : every stimulus of the model goes through this module, so
+// that a run can be recorded and replayed exactly.
+//
+// Input log lines : <step> <port> <hex value>   (# starts a comment)
+//   <step> : simulation step (half period of CLOCK_50) where the value is applied
+//   <port> : KEY, SW, PS2_CLK, PS2_DAT, KB (keys injected in the matrix)
+
+#ifndef _Z88_INPUT_H_INCLUDED
+#define _Z88_INPUT_H_INCLUDED
+
+#include <stdint.h>
+
+enum InPort
+{
+    IN_KEY,
+    IN_SW,
+    IN_PS2_CLK,
+    IN_PS2_DAT,
+    IN_KB,
+    IN_NUM_PORTS
+};
+
+// Record the inputs into a log (NULL : stop recording)
+extern bool in_record(const char *file_name);
+
+// Replay a log, the live inputs are then ignored
+extern bool in_play(const char *file_name);
+
+// Current simulation step, applies the replayed inputs
+extern void in_step(uint64_t step);
+
+// Live input (keyboard script, PS/2 device, reset, ...)
+extern void in_set(int port, uint64_t value);
+
+// Value applied to the model
+extern uint64_t in_get(int port);
+
+// Flush and close the logs
+extern void in_close(void);
+
+#endif
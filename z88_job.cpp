@@ -0,0 +1,242 @@
+// Simulation jobs running in forked processes
+//
+// The statistics of a job come back through a pipe, they fit in the pipe
+// buffer so the child never blocks on it.
+
+#include "z88_job.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <climits>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+struct JobStats
+{
+    int      frames;
+    uint64_t sim_ps;
+    double   secs;
+};
+
+std::vector<Job> job_list;
+int job_self = -1;
+
+static std::vector<int> job_pipe;  // Read side (coordinator), write side (child)
+static int job_num;                // Jobs running
+static std::string job_home;       // Launch directory, empty before job_enter()
+
+int job_load(const char *file_name)
+{
+    FILE *fh = fopen(file_name, "r");
+    char line[1024];
+
+    if (fh == NULL)
+    {
+        printf("Cannot open job list \"%s\".\n", file_name);
+        return 0;
+    }
+    while (fgets(line, sizeof(line), fh))
+    {
+        char *tok;
+        int idx;
+
+        if (strchr(line, '#')) *strchr(line, '#') = '\0';
+        tok = strtok(line, " \t\r\n");
+        if (tok == NULL) continue;
+
+        idx = job_add(tok);
+        while ((tok = strtok(NULL, " \t\r\n")))
+        {
+            job_list[idx].args.push_back(tok);
+        }
+    }
+    fclose(fh);
+    printf("Loaded %lu jobs from \"%s\".\n", job_list.size(), file_name);
+    return job_list.size();
+}
+
+int job_add(const char *name)
+{
+    Job job;
+
+    job.name   = name;
+    job.pid    = 0;
+    job.status = 0;
+    job.frames = 0;
+    job.sim_ps = 0;
+    job.secs   = 0.0;
+    job_list.push_back(job);
+    job_pipe.push_back(-1);
+    return job_list.size() - 1;
+}
+
+int job_active(void)
+{
+    return job_num;
+}
+
+const char *job_plus_match(const char *prefix)
+{
+    size_t len = strlen(prefix);
+
+    if (job_self < 0) return NULL;
+
+    const std::vector<std::string> &args = job_list[job_self].args;
+    for (size_t i = 0; i < args.size(); i++)
+    {
+        if (args[i][0] == '+' && !args[i].compare(1, len, prefix)) return args[i].c_str();
+    }
+    return NULL;
+}
+
+bool job_start(int idx)
+{
+    Job &job = job_list[idx];
+    int fds[2];
+    int pid;
+
+    if (pipe(fds))
+    {
+        job.status = -1;
+        return false;
+    }
+    // Nothing buffered must be written twice
+    fflush(NULL);
+
+    pid = fork();
+    if (pid < 0)
+    {
+        printf("Cannot start job \"%s\".\n", job.name.c_str());
+        close(fds[0]);
+        close(fds[1]);
+        job.status = -1;
+        return false;
+    }
+    if (pid == 0)
+    {
+        // Child : only keeps its own report pipe
+        for (size_t i = 0; i < job_pipe.size(); i++)
+        {
+            if (job_pipe[i] >= 0) close(job_pipe[i]);
+            job_pipe[i] = -1;
+        }
+        close(fds[0]);
+        job_pipe[idx] = fds[1];
+        job_self = idx;
+        job_num  = 0;
+        return true;
+    }
+    close(fds[1]);
+    job_pipe[idx] = fds[0];
+    job.pid = pid;
+    job_num++;
+    printf("Job \"%s\" started (pid %d)\n", job.name.c_str(), pid);
+    return false;
+}
+
+void job_enter(void)
+{
+    const char *dir = job_list[job_self].name.c_str();
+    char cwd[PATH_MAX];
+
+    if (getcwd(cwd, sizeof(cwd))) job_home = cwd;
+    mkdir(dir, 0755);
+    if (chdir(dir))
+    {
+        printf("Cannot enter job directory \"%s\".\n", dir);
+        _exit(-1);
+    }
+    if (!freopen("z88.out", "w", stdout)) _exit(-1);
+}
+
+std::string job_input(const char *file_name)
+{
+    if (job_home.empty() || (file_name[0] == '/')) return file_name;
+    return job_home + "/" + file_name;
+}
+
+int job_wait(void)
+{
+    int status;
+    int pid = wait(&status);
+
+    if (pid < 0) return -1;
+
+    for (size_t i = 0; i < job_list.size(); i++)
+    {
+        Job &job = job_list[i];
+        JobStats st;
+
+        if (job.pid != pid) continue;
+
+        job.status = (WIFEXITED(status)) ? WEXITSTATUS(status) : -1;
+        if (read(job_pipe[i], &st, sizeof(st)) == (ssize_t)sizeof(st))
+        {
+            job.frames = st.frames;
+            job.sim_ps = st.sim_ps;
+            job.secs   = st.secs;
+        }
+        close(job_pipe[i]);
+        job_pipe[i] = -1;
+        job_num--;
+        printf("Job \"%s\" finished (%s)\n", job.name.c_str(), (job.status) ? "FAIL" : "PASS");
+        return i;
+    }
+    // Not a job
+    return job_wait();
+}
+
+int job_run(int jobs)
+{
+    for (size_t i = 0; i < job_list.size(); i++)
+    {
+        while (job_num >= jobs)
+        {
+            job_wait();
+        }
+        if (job_start(i)) return i;
+    }
+    while (job_wait() >= 0);
+    return -1;
+}
+
+void job_report(int frames, uint64_t sim_ps, double secs)
+{
+    JobStats st;
+
+    if ((job_self < 0) || (job_pipe[job_self] < 0)) return;
+
+    st.frames = frames;
+    st.sim_ps = sim_ps;
+    st.secs   = secs;
+    if (write(job_pipe[job_self], &st, sizeof(st)) != (ssize_t)sizeof(st))
+    {
+        printf("Cannot send job statistics.\n");
+    }
+    close(job_pipe[job_self]);
+    job_pipe[job_self] = -1;
+}
+
+int job_summary(double secs)
+{
+    uint64_t sim_ps = 0;
+    int failed = 0;
+
+    printf("\n%-24s  %6s  %8s  %10s  %8s\n", "Job", "Status", "Frames", "Sim (ms)", "Wall (s)");
+    for (size_t i = 0; i < job_list.size(); i++)
+    {
+        const Job &job = job_list[i];
+
+        printf("%-24s  %6s  %8d  %10.1f  %8.1f\n", job.name.c_str(), (job.status) ? "FAIL" : "PASS",
+               job.frames, (double)job.sim_ps / 1e9, job.secs);
+        if (job.status) failed++;
+        sim_ps += job.sim_ps;
+    }
+    printf("\n%lu jobs, %d failed, %.1f ms simulated in %.1f s", job_list.size(), failed,
+           (double)sim_ps / 1e9, secs);
+    if (secs > 0.0) printf(" (%.2f ms/s)", (double)sim_ps / 1e9 / secs);
+    printf("\n");
+    return failed;
+}
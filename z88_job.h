@@ -0,0 +1,70 @@
+// Simulation jobs running in forked processes
+//
+// Job list lines : <name> [+<option>=<value> ...]   (# starts a comment)
+// Each job runs in its own process and in its own "<name>" directory. A job
+// started from a running simulation inherits its whole state copy-on-write.
+//
+// File options : the input files (+play=, +kbd=, +load=) and the coverage
+// file (+cov=, read and written back) are relative to the launch directory,
+// the outputs (+rec=, +btrace=, +tcheck=, logs, VCD) to the job directory.
+
+#ifndef _Z88_JOB_H_INCLUDED
+#define _Z88_JOB_H_INCLUDED
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+struct Job
+{
+    std::string              name;
+    std::vector<std::string> args;    // "+option=value"
+    int                      pid;     // 0 : not started
+    int                      status;  // Exit code, -1 : crashed
+    // Reported by the job
+    int                      frames;
+    uint64_t                 sim_ps;
+    double                   secs;
+};
+
+extern std::vector<Job> job_list;
+
+// Index of the job run by this process, -1 in the coordinator
+extern int job_self;
+
+// Read a job list, returns the number of jobs (0 on error)
+extern int job_load(const char *file_name);
+
+// Add a job without options, returns its index
+extern int job_add(const char *name);
+
+// Number of jobs running
+extern int job_active(void);
+
+// Option of the current job ("+option=value"), NULL if not given
+extern const char *job_plus_match(const char *prefix);
+
+// Fork job "idx" : returns true in the child
+extern bool job_start(int idx);
+
+// Move the job into its directory, the console output goes to "z88.out" (child)
+extern void job_enter(void);
+
+// Path of an input file given relative to the launch directory (unchanged
+// before job_enter())
+extern std::string job_input(const char *file_name);
+
+// Wait for a job to finish, returns its index (-1 : no job running)
+extern int job_wait(void);
+
+// Run all the jobs, at most "jobs" at a time : returns the job index in the
+// children, -1 in the coordinator once everything has finished
+extern int job_run(int jobs);
+
+// Send the job statistics to the coordinator (child)
+extern void job_report(int frames, uint64_t sim_ps, double secs);
+
+// Print the results (coordinator), returns the number of failed jobs
+extern int job_summary(double secs);
+
+#endif
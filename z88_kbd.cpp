@@ -0,0 +1,314 @@
+// Keyboard scripts : keys injected in the Z88 keyboard matrix at run time
+//
+// A script is compiled into a list of actions (set keys, clear keys, wait)
+// run against the frame counter or the simulation step. The resulting matrix
+// goes through the input module, so it is recorded and replayed like the
+// other inputs.
+
+#include "z88_kbd.h"
+#include "z88_input.h"
+#include "z88_ps2.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <strings.h>
+#include <vector>
+
+enum KbdOp
+{
+    KBD_SET,   // Press keys
+    KBD_CLR,   // Release keys
+    KBD_WAIT,  // Wait frames or steps
+    KBD_SCAN   // Send scancodes
+};
+
+struct KbdAct
+{
+    KbdOp    op;
+    uint64_t mask;  // KBD_SET / KBD_CLR, KBD_SCAN : up to 8 bytes
+    int      num;   // KBD_WAIT, KBD_SCAN : number of bytes
+    bool     ms;    // KBD_WAIT : milliseconds instead of frames
+};
+
+struct KbdKey
+{
+    const char *name;
+    int         bit;
+};
+
+// Matrix bits (see KB_MATRIX_P2 in z88_de1_top.v)
+static const KbdKey kbd_keys[] =
+{
+    { "8",      0 }, { "7",      1 }, { "N",      2 }, { "H",      3 },
+    { "Y",      4 }, { "6",      5 }, { "Enter",  6 }, { "Del",    7 },
+    { "I",      8 }, { "U",      9 }, { "B",     10 }, { "G",     11 },
+    { "T",     12 }, { "5",     13 }, { "Up",    14 }, { "\\",    15 },
+    { "O",     16 }, { "J",     17 }, { "V",     18 }, { "F",     19 },
+    { "R",     20 }, { "4",     21 }, { "Down",  22 }, { "=",     23 },
+    { "9",     24 }, { "K",     25 }, { "C",     26 }, { "D",     27 },
+    { "E",     28 }, { "3",     29 }, { "Right", 30 }, { "-",     31 },
+    { "P",     32 }, { "M",     33 }, { "X",     34 }, { "S",     35 },
+    { "W",     36 }, { "2",     37 }, { "Left",  38 }, { "]",     39 },
+    { "0",     40 }, { "L",     41 }, { "Z",     42 }, { "A",     43 },
+    { "Q",     44 }, { "1",     45 }, { "Space", 46 }, { "[",     47 },
+    { "\"",    48 }, { "'",     48 }, { ";",     49 }, { ",",     50 },
+    { "Menu",  51 }, { "Diamond",52 }, { "Tab",  53 }, { "Shift", 54 },
+    { "LShift",54 }, { "Help",  55 }, { "£",     56 }, { "/",     57 },
+    { ".",     58 }, { "Caps",  59 }, { "Index", 60 }, { "Esc",   61 },
+    { "Square",62 }, { "RShift",63 },
+    { NULL,    -1 }
+};
+
+// Characters typed with Shift : character, key
+static const char *kbd_shifted[] =
+{
+    "\"'", ":;", "+=", "_-", "<,", ">.", "?/", "!1", "@2", "#3", "$4",
+    "%5", "^6", "&7", "*8", "(9", ")0", "{[", "}]", "|\\",
+    NULL
+};
+
+static std::vector<KbdAct> kbd_act;
+static size_t   kbd_pos;
+static uint64_t kbd_matrix;
+static uint64_t kbd_spms;       // Simulation steps per ms
+static bool     kbd_wait;       // Waiting for kbd_until
+static bool     kbd_wait_ms;
+static uint64_t kbd_until;      // Frame or step
+
+int kbd_key(const char *name)
+{
+    for (int i = 0; kbd_keys[i].name; i++)
+    {
+        if (!strcasecmp(name, kbd_keys[i].name)) return kbd_keys[i].bit;
+    }
+    return -1;
+}
+
+// "Shift+A" -> matrix mask, 0 if a key is unknown
+static uint64_t kbd_chord(const char *chord)
+{
+    char keys[64];
+    uint64_t mask = 0;
+
+    strncpy(keys, chord, sizeof(keys) - 1);
+    keys[sizeof(keys) - 1] = '\0';
+    // A single "+" is the key name, "Shift++" is Shift and "+"
+    for (char *k = keys; *k; )
+    {
+        char *e = strchr(k + 1, '+');
+        int bit;
+
+        if (e) *e = '\0';
+        bit = kbd_key(k);
+        if (bit < 0)
+        {
+            printf("Unknown key \"%s\" in \"%s\".\n", k, chord);
+            return 0;
+        }
+        mask |= (uint64_t)1 << bit;
+        if (!e) break;
+        k = e + 1;
+    }
+    return mask;
+}
+
+// Key(s) of a typed character
+static uint64_t kbd_char(char c)
+{
+    char name[2] = { c, 0 };
+    int bit;
+
+    for (int i = 0; kbd_shifted[i]; i++)
+    {
+        if (kbd_shifted[i][0] == c)
+        {
+            name[0] = kbd_shifted[i][1];
+            return ((uint64_t)1 << kbd_key("Shift")) | ((uint64_t)1 << kbd_key(name));
+        }
+    }
+    if (c == ' ')  return (uint64_t)1 << kbd_key("Space");
+    if (c == '\n') return (uint64_t)1 << kbd_key("Enter");
+    if (c == '\t') return (uint64_t)1 << kbd_key("Tab");
+    // Letters : the case comes from the Z88 (Caps Lock)
+    bit = kbd_key(name);
+    return (bit < 0) ? 0 : (uint64_t)1 << bit;
+}
+
+static bool kbd_time(const char *arg, KbdAct &act)
+{
+    char *end;
+
+    act.op  = KBD_WAIT;
+    act.num = strtol(arg, &end, 10);
+    act.ms  = !strcasecmp(end, "ms");
+    return (end != arg) && (!*end || act.ms);
+}
+
+static void kbd_stroke(uint64_t mask, const KbdAct &hold, const KbdAct &gap)
+{
+    KbdAct act;
+
+    act.op   = KBD_SET;
+    act.mask = mask;
+    kbd_act.push_back(act);
+    kbd_act.push_back(hold);
+    act.op   = KBD_CLR;
+    kbd_act.push_back(act);
+    kbd_act.push_back(gap);
+}
+
+bool kbd_load(const char *file_name, uint64_t steps_per_ms)
+{
+    FILE *fh = fopen(file_name, "r");
+    char line[512];
+    int num = 0;
+    KbdAct hold = { KBD_WAIT, 0, 1, false };
+    KbdAct gap  = { KBD_WAIT, 0, 3, false };
+
+    if (fh == NULL)
+    {
+        printf("Cannot open keyboard script \"%s\".\n", file_name);
+        return false;
+    }
+    kbd_act.clear();
+    while (fgets(line, sizeof(line), fh))
+    {
+        char cmd[16];
+        char arg[256];
+        KbdAct act;
+
+        num++;
+        // Comments : outside of a typed text
+        if (line[strspn(line, " \t")] == '#') continue;
+        if (sscanf(line, " %15s %255[^\r\n]", cmd, arg) != 2) continue;
+
+        if (!strcmp(cmd, "delay") || !strcmp(cmd, "hold") || !strcmp(cmd, "gap"))
+        {
+            if (!kbd_time(arg, act))
+            {
+                printf("%s:%d : bad time \"%s\".\n", file_name, num, arg);
+                continue;
+            }
+            if      (cmd[0] == 'd') kbd_act.push_back(act);
+            else if (cmd[0] == 'h') hold = act;
+            else                    gap  = act;
+        }
+        else if (!strcmp(cmd, "key") || !strcmp(cmd, "press") || !strcmp(cmd, "release"))
+        {
+            char *end = arg + strcspn(arg, " \t#");
+
+            *end = '\0';
+            act.mask = kbd_chord(arg);
+            if (!act.mask) continue;
+            if (cmd[0] == 'k')
+            {
+                kbd_stroke(act.mask, hold, gap);
+            }
+            else
+            {
+                act.op = (cmd[0] == 'p') ? KBD_SET : KBD_CLR;
+                kbd_act.push_back(act);
+            }
+        }
+        else if (!strcmp(cmd, "scan"))
+        {
+            char *end = arg;
+
+            act.op   = KBD_SCAN;
+            act.mask = 0;
+            act.num  = 0;
+            while (act.num < 8)
+            {
+                char *hex = end;
+                uint64_t code = strtoul(hex, &end, 16);
+
+                if (end == hex) break;
+                act.mask |= (code & 0xFF) << (act.num++ * 8);
+            }
+            kbd_act.push_back(act);
+        }
+        else if (!strcmp(cmd, "type") && (arg[0] == '"'))
+        {
+            for (char *c = arg + 1; *c && (*c != '"'); c++)
+            {
+                uint64_t mask;
+
+                if (*c == '\\' && c[1])
+                {
+                    c++;
+                    if (*c == 'n') *c = '\n';
+                    if (*c == 't') *c = '\t';
+                }
+                mask = kbd_char(*c);
+                if (!mask)
+                {
+                    printf("%s:%d : cannot type '%c'.\n", file_name, num, *c);
+                    continue;
+                }
+                kbd_stroke(mask, hold, gap);
+            }
+        }
+        else
+        {
+            printf("%s:%d : unknown command \"%s\".\n", file_name, num, cmd);
+        }
+    }
+    fclose(fh);
+
+    kbd_pos    = 0;
+    kbd_spms   = steps_per_ms;
+    kbd_wait   = false;
+    kbd_matrix = 0;
+    in_set(IN_KB, 0);
+    printf("Loaded %lu keyboard actions from \"%s\".\n", kbd_act.size(), file_name);
+    return true;
+}
+
+void kbd_update(uint64_t step, int frame)
+{
+    if (kbd_wait)
+    {
+        if ((kbd_wait_ms ? step : (uint64_t)frame) < kbd_until) return;
+        kbd_wait = false;
+    }
+    while (kbd_pos < kbd_act.size())
+    {
+        const KbdAct &act = kbd_act[kbd_pos++];
+
+        switch (act.op)
+        {
+            case KBD_SET :
+            case KBD_CLR :
+            {
+                uint64_t prev = kbd_matrix;
+
+                if (act.op == KBD_SET)
+                    kbd_matrix |= act.mask;
+                else
+                    kbd_matrix &= ~act.mask;
+                if (ps2_enabled())
+                    ps2_matrix(prev, kbd_matrix);
+                else
+                    in_set(IN_KB, kbd_matrix);
+                break;
+            }
+            case KBD_SCAN :
+                for (int i = 0; i < act.num; i++)
+                {
+                    if (ps2_enabled()) ps2_send(act.mask >> (i * 8));
+                }
+                break;
+            case KBD_WAIT :
+                kbd_wait    = true;
+                kbd_wait_ms = act.ms;
+                kbd_until   = (act.ms) ? step + act.num * kbd_spms : (uint64_t)frame + act.num;
+                return;
+        }
+    }
+}
+
+bool kbd_done(void)
+{
+    return kbd_pos >= kbd_act.size();
+}
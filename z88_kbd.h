@@ -0,0 +1,36 @@
+// Keyboard scripts : keys injected in the Z88 keyboard matrix at run time
+//
+// Script lines (# starts a comment), <time> is a number of frames or "<num>ms" :
+//   delay <time>          : wait
+//   hold <time>           : key press duration (default : 1 frame)
+//   gap <time>            : wait after a key release (default : 3 frames)
+//   key <key>[+<key>...]  : press and release a key or a chord (e.g. Shift+")
+//   press <key>[+<key>...], release <key>[+<key>...] : keys held across lines
+//   type "<text>"         : types a text (\" and \n escapes, \n is Enter)
+//   scan <hex> ...        : raw scancodes (PS/2 keyboard only)
+//
+// With the PS/2 keyboard model enabled, the keys are sent as scancodes on the
+// PS/2 pins instead of being injected in the matrix.
+//
+// Key names : A..Z, 0..9, the symbols of the keycaps, Enter, Del, Space, Tab,
+// Up, Down, Left, Right, Shift (LShift), RShift, Caps, Esc, Menu, Help, Index,
+// Diamond, Square
+
+#ifndef _Z88_KBD_H_INCLUDED
+#define _Z88_KBD_H_INCLUDED
+
+#include <stdint.h>
+
+// Matrix bit of a key name, -1 if unknown
+extern int kbd_key(const char *name);
+
+// Load a script, it starts at the next kbd_update() call
+extern bool kbd_load(const char *file_name, uint64_t steps_per_ms);
+
+// Run the script up to the current time
+extern void kbd_update(uint64_t step, int frame);
+
+// Script finished (or no script)
+extern bool kbd_done(void);
+
+#endif
@@ -0,0 +1,285 @@
+// Z88 physical memory (4 MB Blink address map)
+
+#include "z88_mem.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Shared contents of the banks that were never written
+static uint8_t blank_00[MEM_BANK_SIZE];
+static uint8_t blank_ff[MEM_BANK_SIZE];
+
+Z88Memory *z88_mem = NULL;
+
+Z88Memory::Z88Memory()
+{
+    memset(blank_ff, 0xFF, sizeof(blank_ff));
+    memset(page, 0, sizeof(page));
+    memset(page_own, 0, sizeof(page_own));
+    // Slots 1-3 empty
+    set_region(0, MEM_SIZE, MEM_NONE, MEM_SIZE);
+    // Slot 0 : 512 KB ROM, 512 KB RAM
+    set_region(MEM_ROM_BASE, MEM_RAM_BASE - MEM_ROM_BASE, MEM_ROM, MEM_RAM_BASE - MEM_ROM_BASE);
+    set_region(MEM_RAM_BASE, MEM_SLOT_SIZE - MEM_RAM_BASE, MEM_RAM, MEM_SLOT_SIZE - MEM_RAM_BASE);
+}
+
+Z88Memory::~Z88Memory()
+{
+    page_free(0, MEM_NUM_BANKS);
+    for (size_t i = 0; i < maps.size(); i++)
+    {
+        munmap(maps[i].addr, maps[i].len);
+    }
+}
+
+void Z88Memory::page_free(int beg, int num)
+{
+    for (int p = beg; p < beg + num && p < MEM_NUM_BANKS; p++)
+    {
+        if (page_own[p]) free(page[p]);
+        page[p]     = NULL;
+        page_own[p] = false;
+    }
+}
+
+void Z88Memory::set_region(unsigned base, unsigned span, MemType type, unsigned size)
+{
+    int beg = (base & (MEM_SIZE-1)) >> 14;
+    int num = span >> 14;
+    int mir;
+
+    // The mirroring granularity is one bank
+    if (size < MEM_BANK_SIZE) size = MEM_BANK_SIZE;
+    if (size > span) size = span;
+    mir = size >> 14;
+
+    for (int i = 0; i < num && beg + i < MEM_NUM_BANKS; i++)
+    {
+        int b = beg + i;
+        int p = beg + (i % mir);
+
+        bank_type[b] = type;
+        bank_page[b] = p;
+        if (type == MEM_NONE)
+        {
+            rd_ptr[b] = blank_ff;
+        }
+        else
+        {
+            rd_ptr[b] = (page[p]) ? page[p] : (type == MEM_RAM) ? blank_00 : blank_ff;
+        }
+        wr_ptr[b] = (type == MEM_RAM) ? page[p] : NULL;
+    }
+}
+
+void Z88Memory::set_card(int slot, MemType type, unsigned size)
+{
+    if ((slot < 1) || (slot > 3)) return;
+
+    set_region(slot * MEM_SLOT_SIZE, MEM_SLOT_SIZE, type, size);
+}
+
+uint8_t *Z88Memory::page_alloc(int bank)
+{
+    int p = bank_page[bank];
+
+    if (page[p] == NULL)
+    {
+        page[p] = (uint8_t *)malloc(MEM_BANK_SIZE);
+        page_own[p] = true;
+        memcpy(page[p], rd_ptr[bank], MEM_BANK_SIZE);
+        // Update the mirrors
+        for (int b = 0; b < MEM_NUM_BANKS; b++)
+        {
+            if (bank_page[b] != p || bank_type[b] == MEM_NONE) continue;
+            rd_ptr[b] = page[p];
+            if (bank_type[b] == MEM_RAM) wr_ptr[b] = page[p];
+        }
+    }
+    return page[p];
+}
+
+void Z88Memory::write_slow(unsigned phy, uint8_t data)
+{
+    int b = (phy >> 14) & (MEM_NUM_BANKS-1);
+
+    // ROM, EPROM, flash and empty slots are write protected
+    if (bank_type[b] != MEM_RAM) return;
+
+    page_alloc(b)[phy & (MEM_BANK_SIZE-1)] = data;
+}
+
+void Z88Memory::poke(unsigned phy, uint8_t data)
+{
+    int b = (phy >> 14) & (MEM_NUM_BANKS-1);
+
+    if (bank_type[b] == MEM_NONE) return;
+
+    page_alloc(b)[phy & (MEM_BANK_SIZE-1)] = data;
+}
+
+size_t Z88Memory::load(unsigned base, const char *file_name)
+{
+    FILE *fh = fopen(file_name, "rb");
+    uint8_t buf[MEM_BANK_SIZE];
+    size_t len = 0;
+    size_t n;
+
+    if (fh == NULL)
+    {
+        printf("Cannot open memory image \"%s\".\n", file_name);
+        return 0;
+    }
+    while ((n = fread(buf, 1, MEM_BANK_SIZE, fh)) > 0)
+    {
+        for (size_t i = 0; i < n; i++)
+        {
+            poke(base + len + i, buf[i]);
+        }
+        len += n;
+        if (base + len >= MEM_SIZE) break;
+    }
+    fclose(fh);
+    return len;
+}
+
+size_t Z88Memory::map(unsigned base, unsigned span, MemType type, const char *file_name,
+                      MemMapMode mode, unsigned size)
+{
+    bool shared = (mode == MEM_MAP_SHARED);
+    int fd = open(file_name, (shared) ? O_RDWR | O_CREAT : O_RDONLY, 0644);
+    struct stat st;
+    size_t len;
+    void *addr;
+
+    if ((fd < 0) || fstat(fd, &st))
+    {
+        printf("Cannot open memory image \"%s\".\n", file_name);
+        if (fd >= 0) close(fd);
+        return 0;
+    }
+    len = st.st_size;
+    if (shared && (len < size))
+    {
+        // New or short RAM image
+        if (ftruncate(fd, size))
+        {
+            printf("Cannot resize memory image \"%s\".\n", file_name);
+            close(fd);
+            return 0;
+        }
+        len = size;
+    }
+    if (len > span) len = span;
+
+    // Mirroring needs a power of two
+    if ((len < MEM_BANK_SIZE) || (len & (len - 1)))
+    {
+        size_t rnd = MEM_BANK_SIZE;
+
+        close(fd);
+        if (shared)
+        {
+            printf("Memory image \"%s\" size is not a power of two.\n", file_name);
+            return 0;
+        }
+        while (rnd < len) rnd <<= 1;
+        page_free(base >> 14, span >> 14);
+        set_region(base, span, type, rnd);
+        len = load(base, file_name);
+        return (len) ? rnd : 0;
+    }
+
+    addr = mmap(NULL, len, PROT_READ | PROT_WRITE, (shared) ? MAP_SHARED : MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED)
+    {
+        printf("Cannot map memory image \"%s\".\n", file_name);
+        return 0;
+    }
+    MemMap m = { addr, len, shared };
+    maps.push_back(m);
+
+    page_free(base >> 14, span >> 14);
+    for (size_t i = 0; i < (len >> 14); i++)
+    {
+        page[(base >> 14) + i] = (uint8_t *)addr + (i << 14);
+    }
+    set_region(base, span, type, len);
+    return len;
+}
+
+bool Z88Memory::mapped(unsigned phy) const
+{
+    int p = bank_page[(phy >> 14) & (MEM_NUM_BANKS-1)];
+
+    return (page[p] != NULL) && !page_own[p];
+}
+
+void Z88Memory::sync()
+{
+    for (size_t i = 0; i < maps.size(); i++)
+    {
+        if (maps[i].shared) msync(maps[i].addr, maps[i].len, MS_SYNC);
+    }
+}
+
+void Z88Memory::privatize()
+{
+    for (size_t i = 0; i < maps.size(); i++)
+    {
+        uint8_t *beg = (uint8_t *)maps[i].addr;
+        uint8_t *end = beg + maps[i].len;
+
+        if (!maps[i].shared) continue;
+
+        msync(maps[i].addr, maps[i].len, MS_SYNC);
+        for (int p = 0; p < MEM_NUM_BANKS; p++)
+        {
+            uint8_t *src = page[p];
+
+            if ((src < beg) || (src >= end)) continue;
+
+            page[p] = (uint8_t *)malloc(MEM_BANK_SIZE);
+            page_own[p] = true;
+            memcpy(page[p], src, MEM_BANK_SIZE);
+        }
+        munmap(maps[i].addr, maps[i].len);
+        maps.erase(maps.begin() + i--);
+    }
+    // Update the bank pointers
+    for (int b = 0; b < MEM_NUM_BANKS; b++)
+    {
+        uint8_t *p = page[bank_page[b]];
+
+        if (!p || (bank_type[b] == MEM_NONE)) continue;
+        rd_ptr[b] = p;
+        wr_ptr[b] = (bank_type[b] == MEM_RAM) ? p : NULL;
+    }
+}
+
+int Z88Memory::pages() const
+{
+    int num = 0;
+
+    for (int i = 0; i < MEM_NUM_BANKS; i++)
+    {
+        if (page[i]) num++;
+    }
+    return num;
+}
+
+extern "C" int z88_mem_read(int addr)
+{
+    return z88_mem->read(addr);
+}
+
+extern "C" void z88_mem_write(int addr, int data)
+{
+    z88_mem->write(addr, data);
+}
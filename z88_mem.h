@@ -0,0 +1,136 @@
+// Z88 physical memory (4 MB Blink address map)
+//
+//   000000-07FFFF : slot 0, internal ROM
+//   080000-0FFFFF : slot 0, internal RAM
+//   100000-1FFFFF : slot 1, card
+//   200000-2FFFFF : slot 2, card
+//   300000-3FFFFF : slot 3, card
+//
+// Memory is handled in 16 KB banks. A region smaller than its span is mirrored
+// (as the address decoders do), and RAM pages are only allocated when they are
+// first written, so empty slots and unused RAM cost nothing.
+//
+// Images can also be mapped in place (mmap) : ROM and cards are private
+// copy-on-write mappings, RAM can be private (changes are lost at exit) or
+// shared (changes are written back to the file, like a battery-backed RAM).
+
+#ifndef _Z88_MEM_H_INCLUDED
+#define _Z88_MEM_H_INCLUDED
+
+#include <cstddef>
+#include <stdint.h>
+#include <vector>
+
+#define MEM_SIZE      (1<<22)
+#define MEM_BANK_SIZE (1<<14)
+#define MEM_NUM_BANKS (MEM_SIZE / MEM_BANK_SIZE)
+
+#define MEM_ROM_BASE  0x000000
+#define MEM_RAM_BASE  0x080000
+#define MEM_SLOT_SIZE 0x100000
+
+enum MemType
+{
+    MEM_NONE,   // Empty slot, reads $FF
+    MEM_ROM,    // Internal ROM
+    MEM_RAM,    // Internal RAM or RAM card
+    MEM_EPROM,  // EPROM card, read only
+    MEM_FLASH   // Flash card, read only (program/erase commands not modelled)
+};
+
+enum MemMapMode
+{
+    MEM_MAP_PRIVATE,  // Copy-on-write, the file is never modified
+    MEM_MAP_SHARED    // Writes go to the file (created if needed)
+};
+
+class Z88Memory
+{
+public:
+    Z88Memory();
+    ~Z88Memory();
+
+    // Declare "size" bytes of memory at "base", mirrored over "span" bytes
+    void set_region(unsigned base, unsigned span, MemType type, unsigned size);
+    // Card slot 1..3
+    void set_card(int slot, MemType type, unsigned size);
+    // Region type at a physical address
+    MemType type(unsigned phy) const { return bank_type[(phy >> 14) & (MEM_NUM_BANKS-1)]; }
+
+    // Copy an image at "base", returns the number of bytes read (0 on error)
+    size_t load(unsigned base, const char *file_name);
+    // Map an image as a region of "span" bytes at "base", returns the region
+    // size (0 on error). Images that are not a power of two of at least 16 KB
+    // are copied instead. A shared image is extended to "size" bytes if needed.
+    size_t map(unsigned base, unsigned span, MemType type, const char *file_name,
+               MemMapMode mode = MEM_MAP_PRIVATE, unsigned size = 0);
+    // Bank at a physical address is backed by a mapped image (not a copy)
+    bool mapped(unsigned phy) const;
+    // Flush the shared mappings
+    void sync();
+    // Turn the shared mappings into private copies (before a fork)
+    void privatize();
+
+    // CPU accesses (22-bit physical address), write protection applies
+    uint8_t read(unsigned phy) const
+    {
+        return rd_ptr[(phy >> 14) & (MEM_NUM_BANKS-1)][phy & (MEM_BANK_SIZE-1)];
+    }
+    void write(unsigned phy, uint8_t data)
+    {
+        uint8_t *p = wr_ptr[(phy >> 14) & (MEM_NUM_BANKS-1)];
+        if (p) p[phy & (MEM_BANK_SIZE-1)] = data; else write_slow(phy, data);
+    }
+    // Host accesses, write protection ignored
+    void poke(unsigned phy, uint8_t data);
+
+    // DE1 pins : 8-bit flash holds the slot 0 ROM
+    uint8_t flash_read(unsigned fl_addr) const
+    {
+        return read(MEM_ROM_BASE | (fl_addr & (MEM_RAM_BASE-1)));
+    }
+    // DE1 pins : 16-bit SRAM holds the slot 0 RAM (even bytes on D[7:0])
+    uint16_t sram_read(unsigned sram_addr) const
+    {
+        unsigned phy = MEM_RAM_BASE | ((sram_addr << 1) & (MEM_RAM_BASE-1));
+        return read(phy) | (read(phy | 1) << 8);
+    }
+    void sram_write(unsigned sram_addr, uint16_t data, bool lb, bool ub)
+    {
+        unsigned phy = MEM_RAM_BASE | ((sram_addr << 1) & (MEM_RAM_BASE-1));
+        if (lb) write(phy,     data & 0xFF);
+        if (ub) write(phy | 1, data >> 8);
+    }
+
+    // Number of allocated 16 KB pages
+    int pages() const;
+
+private:
+    struct MemMap
+    {
+        void   *addr;
+        size_t  len;
+        bool    shared;
+    };
+
+    uint8_t *page_alloc(int bank);
+    void     page_free(int beg, int num);
+    void     write_slow(unsigned phy, uint8_t data);
+
+    MemType  bank_type[MEM_NUM_BANKS];  // Region type
+    int      bank_page[MEM_NUM_BANKS];  // Backing page (mirroring)
+    uint8_t *page[MEM_NUM_BANKS];       // Allocated pages, NULL if never written
+    bool     page_own[MEM_NUM_BANKS];   // Page allocated (not mapped)
+    std::vector<MemMap> maps;
+    const uint8_t *rd_ptr[MEM_NUM_BANKS];
+    uint8_t *wr_ptr[MEM_NUM_BANKS];     // NULL : read only or not allocated
+};
+
+// Instance used by the DPI functions
+extern Z88Memory *z88_mem;
+
+// DPI access (import "DPI-C" function int z88_mem_read(input int addr))
+extern "C" int  z88_mem_read(int addr);
+extern "C" void z88_mem_write(int addr, int data);
+
+#endif
@@ -0,0 +1,59 @@
+// Debug probe : DBG_PROBE output of z88_de1_top (simulation only)
+//
+// The state followed by the testbench (registers, bus, MMU, screen) is
+// bundled into 32-bit words (see the end of z88_top.v), read from the
+// model outputs instead of public signals deep in the hierarchy. "p" points
+// to the words (top->DBG_PROBE), the values are the ones of the last eval().
+
+#ifndef _Z88_PROBE_H_INCLUDED
+#define _Z88_PROBE_H_INCLUDED
+
+#define PRB_WORDS        19
+
+// Z80 registers
+#define PRB_PC(p)        ((p)[0] & 0xFFFF)
+#define PRB_SP(p)        ((p)[0] >> 16)
+#define PRB_A(p)         (((p)[1] >>  8) & 0xFF)
+#define PRB_F(p)         ((p)[1] & 0xFF)
+#define PRB_B(p)         ((p)[1] >> 24)
+#define PRB_C(p)         (((p)[1] >> 16) & 0xFF)
+#define PRB_D(p)         (((p)[2] >>  8) & 0xFF)
+#define PRB_E(p)         ((p)[2] & 0xFF)
+#define PRB_H(p)         ((p)[2] >> 24)
+#define PRB_L(p)         (((p)[2] >> 16) & 0xFF)
+#define PRB_IX(p)        ((p)[3] & 0xFFFF)
+#define PRB_IY(p)        ((p)[3] >> 16)
+
+// Blink MMU
+#define PRB_SR(p, n)     (((p)[4] >> ((n) * 8)) & 0xFF)
+#define PRB_COM(p)       ((p)[5] >> 24)
+
+// Z80 bus
+#define PRB_RDATA(p)     (((p)[5] >> 16) & 0xFF)  // Data read by the Z80
+#define PRB_ADDR(p)      ((p)[5] & 0xFFFF)
+#define PRB_M1_N(p)      (((p)[6] >> 24) & 1)
+#define PRB_MREQ_N(p)    (((p)[6] >> 25) & 1)
+#define PRB_HALT_N(p)    (((p)[6] >> 26) & 1)
+#define PRB_CLK_ENA(p)   (((p)[6] >> 27) & 1)
+
+// PC trace buffer (PC_TRACE build-time parameter), entries read through
+// the PCT_IDX / PCT_DAT simulation port
+#define PRB_PCT_WRP(p)   ((p)[7] & 0xFFFF)  // Next entry written
+#define PRB_PCT_FULL(p)  (((p)[7] >> 30) & 1)
+#define PRB_PCT_FRZ(p)   ((p)[7] >> 31)     // Frozen by a trigger
+
+// Screen
+#define PRB_VRAM_ADDR(p) ((p)[6] & 0x7FFF)
+#define PRB_VRAM_DATA(p) (((p)[6] >> 16) & 7)
+#define PRB_VRAM_WE(p)   (((p)[6] >> 28) & 1)
+#define PRB_FR_TGL(p)    (((p)[6] >> 29) & 1)
+
+// ROM cache (ROM_CACHE build-time parameter)
+#define PRB_RC_HITS(p)   ((p)[8])
+#define PRB_RC_MISSES(p) ((p)[9])
+
+// Blink performance counters (see z88_blink.v), also read at I/O $F0 - $F4
+#define PRB_PERF_NUM     9
+#define PRB_PERF(p, n)   ((p)[10 + (n)])
+
+#endif
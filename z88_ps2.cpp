@@ -0,0 +1,220 @@
+// PS/2 keyboard device model on the PS2_CLK / PS2_DAT pins
+//
+// Both lines are open collector : the level seen by the model is the AND of
+// the device and host drivers. The lines go through the input module.
+
+#include "z88_ps2.h"
+#include "z88_input.h"
+
+#include <cstdio>
+#include <deque>
+
+enum Ps2State
+{
+    PS2_IDLE,  // Lines released
+    PS2_TX,    // Device to host frame
+    PS2_RX     // Host to device frame (the device drives the clock)
+};
+
+// Scancodes of the matrix bits (see KB_MATRIX_P2 in z88_de1_top.v),
+// bit 7 set : extended key (E0 prefix)
+static const uint8_t ps2_code[64] =
+{
+    0x3E, 0x3D, 0x31, 0x33, 0x35, 0x36, 0x5A, 0x66,  // A8  : 8 7 N H Y 6 Enter Del
+    0x43, 0x3C, 0x32, 0x34, 0x2C, 0x2E, 0xF5, 0x5D,  // A9  : I U B G T 5 Up Backslash
+    0x44, 0x3B, 0x2A, 0x2B, 0x2D, 0x25, 0xF2, 0x55,  // A10 : O J V F R 4 Down =
+    0x46, 0x42, 0x21, 0x23, 0x24, 0x26, 0xF4, 0x4E,  // A11 : 9 K C D E 3 Right -
+    0x4D, 0x3A, 0x22, 0x1B, 0x1D, 0x1E, 0xEB, 0x5B,  // A12 : P M X S W 2 Left ]
+    0x45, 0x4B, 0x1A, 0x1C, 0x15, 0x16, 0x29, 0x54,  // A13 : 0 L Z A Q 1 Space [
+    0x52, 0x4C, 0x41, 0x04, 0x14, 0x0D, 0x12, 0x05,  // A14 : " ; , Menu <> Tab LShift Help
+    0x0E, 0x4A, 0x49, 0x58, 0x06, 0x76, 0x11, 0x59   // A15 : £ / . Caps Index Esc [] RShift
+};
+
+// Modifiers : pressed first, released last
+static const uint64_t ps2_mods = ((uint64_t)1 << 52) | ((uint64_t)1 << 54) |
+                                 ((uint64_t)1 << 62) | ((uint64_t)1 << 63);
+
+static bool     ps2_on;
+static unsigned ps2_half;
+static std::deque<uint8_t> ps2_fifo;
+
+static Ps2State ps2_state;
+static uint64_t ps2_next;   // Step of the next clock edge
+static int      ps2_bit;    // Clock pulses done in the frame
+static bool     ps2_low;    // Clock low phase
+static unsigned ps2_frame;  // TX frame / RX data bits
+static bool     ps2_clk;    // Device drivers (true : released)
+static bool     ps2_dat;
+static bool     ps2_led;    // Next host byte is the LEDs state
+
+void ps2_init(unsigned half)
+{
+    ps2_on    = true;
+    ps2_half  = half;
+    ps2_state = PS2_IDLE;
+    ps2_next  = 0;
+    ps2_clk   = true;
+    ps2_dat   = true;
+    ps2_led   = false;
+    in_set(IN_PS2_CLK, 1);
+    in_set(IN_PS2_DAT, 1);
+    printf("PS/2 keyboard : %u steps per half clock period\n", half);
+}
+
+bool ps2_enabled(void)
+{
+    return ps2_on;
+}
+
+void ps2_send(uint8_t code)
+{
+    ps2_fifo.push_back(code);
+}
+
+static void ps2_key(int bit, bool make)
+{
+    uint8_t code = ps2_code[bit];
+
+    if (code & 0x80) ps2_send(0xE0);
+    if (!make)       ps2_send(0xF0);
+    ps2_send(code & 0x7F);
+}
+
+void ps2_matrix(uint64_t prev, uint64_t next)
+{
+    uint64_t make = next & ~prev;
+    uint64_t brk  = prev & ~next;
+
+    for (int i = 0; i < 64; i++)
+        if ((brk  >> i) & ~(ps2_mods >> i) & 1) ps2_key(i, false);
+    for (int i = 0; i < 64; i++)
+        if ((brk  >> i) &  (ps2_mods >> i) & 1) ps2_key(i, false);
+    for (int i = 0; i < 64; i++)
+        if ((make >> i) &  (ps2_mods >> i) & 1) ps2_key(i, true);
+    for (int i = 0; i < 64; i++)
+        if ((make >> i) & ~(ps2_mods >> i) & 1) ps2_key(i, true);
+}
+
+// Host command received
+static void ps2_command(uint8_t cmd)
+{
+    std::deque<uint8_t> ans;
+
+    if (ps2_led)
+    {
+        // LEDs state
+        ans.push_back(0xFA);
+        ps2_led = false;
+    }
+    else switch (cmd)
+    {
+        case 0xED : ans.push_back(0xFA); ps2_led = true; break;            // Set LEDs
+        case 0xEE : ans.push_back(0xEE); break;                            // Echo
+        case 0xF2 : ans.push_back(0xFA); ans.push_back(0xAB);              // Read ID
+                    ans.push_back(0x83); break;
+        case 0xFF : ans.push_back(0xFA); ans.push_back(0xAA); break;       // Reset
+        default   : ans.push_back(0xFA); break;
+    }
+    // Answers go before the pending scancodes
+    ps2_fifo.insert(ps2_fifo.begin(), ans.begin(), ans.end());
+}
+
+void ps2_update(uint64_t step, bool host_clk_low, bool host_dat_low)
+{
+    if (!ps2_on) return;
+
+    switch (ps2_state)
+    {
+        case PS2_IDLE :
+            if (host_clk_low || (step < ps2_next)) break;
+            if (host_dat_low)
+            {
+                // Request to send : the device clocks the host frame in
+                ps2_state = PS2_RX;
+                ps2_bit   = 0;
+                ps2_low   = false;
+                ps2_frame = 0;
+                ps2_next  = step + ps2_half;
+            }
+            else if (!ps2_fifo.empty())
+            {
+                uint8_t  code = ps2_fifo.front();
+                unsigned par  = 1;
+
+                for (int i = 0; i < 8; i++) par ^= (code >> i) & 1;
+                // Start, data, odd parity, stop
+                ps2_frame = (code << 1) | (par << 9) | (1 << 10);
+                ps2_state = PS2_TX;
+                ps2_bit   = 0;
+                ps2_low   = false;
+                ps2_dat   = false;
+                ps2_next  = step + ps2_half;
+            }
+            break;
+
+        case PS2_TX :
+            if (host_clk_low && !ps2_low)
+            {
+                // Host inhibit : the byte is sent again later
+                ps2_state = PS2_IDLE;
+                ps2_clk   = true;
+                ps2_dat   = true;
+                ps2_next  = step + 2 * ps2_half;
+                break;
+            }
+            if (step < ps2_next) break;
+            ps2_next += ps2_half;
+            if (!ps2_low)
+            {
+                // Falling edge : the host samples the data
+                ps2_clk = false;
+                ps2_low = true;
+                break;
+            }
+            ps2_clk = true;
+            ps2_low = false;
+            if (++ps2_bit == 11)
+            {
+                ps2_fifo.pop_front();
+                ps2_state = PS2_IDLE;
+                ps2_dat   = true;
+                ps2_next  = step + 2 * ps2_half;
+                break;
+            }
+            ps2_dat = (ps2_frame >> ps2_bit) & 1;
+            break;
+
+        case PS2_RX :
+            if (step < ps2_next) break;
+            ps2_next += ps2_half;
+            if (!ps2_low)
+            {
+                ps2_clk = false;
+                ps2_low = true;
+                break;
+            }
+            // Rising edge : the host data is stable
+            ps2_clk = true;
+            ps2_low = false;
+            ps2_bit++;
+            if (ps2_bit <= 8)
+            {
+                ps2_frame |= (host_dat_low ? 0 : 1) << (ps2_bit - 1);
+            }
+            else if (ps2_bit == 10)
+            {
+                // Stop bit received : acknowledge
+                ps2_dat = false;
+            }
+            else if (ps2_bit == 11)
+            {
+                ps2_dat   = true;
+                ps2_state = PS2_IDLE;
+                ps2_next  = step + 2 * ps2_half;
+                ps2_command(ps2_frame);
+            }
+            break;
+    }
+    in_set(IN_PS2_CLK, ps2_clk && !host_clk_low);
+    in_set(IN_PS2_DAT, ps2_dat && !host_dat_low);
+}
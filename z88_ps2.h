@@ -0,0 +1,32 @@
+// PS/2 keyboard device model on the PS2_CLK / PS2_DAT pins
+//
+// The device sends the queued bytes as 11-bit frames (start, 8 data bits LSB
+// first, odd parity, stop) and answers the host commands (LEDs, reset, echo,
+// ID) sent by ps2_keyboard.v. A real keyboard clock runs at ~12.5 kHz
+// (4000 simulation steps per half period), the "fast" mode uses a much
+// shorter period that ps2_keyboard.v still samples correctly.
+
+#ifndef _Z88_PS2_H_INCLUDED
+#define _Z88_PS2_H_INCLUDED
+
+#include <stdint.h>
+
+#define PS2_HALF_REAL  4000  // 40 us
+#define PS2_HALF_FAST    80  // 0.8 us (5 samples of ps2_keyboard.v)
+
+// Enable the device, "half" : clock half period in simulation steps
+extern void ps2_init(unsigned half);
+
+// Device enabled
+extern bool ps2_enabled(void);
+
+// Queue a byte (scancode)
+extern void ps2_send(uint8_t code);
+
+// Queue the make / break codes of the keys changed between two matrix states
+extern void ps2_matrix(uint64_t prev, uint64_t next);
+
+// Run the device, host_clk_low / host_dat_low : lines driven by the host
+extern void ps2_update(uint64_t step, bool host_clk_low, bool host_dat_low);
+
+#endif
@@ -0,0 +1,472 @@
+// Whole-ROM static disassembler
+//
+// Loads a ROM image the same way as the testbench (padded to a power of two)
+// and separates code from data with a recursive descent from known entry
+// points. The 16 KB banks are traced and listed in parallel.
+//
+// Targets outside the segment of their bank are resolved through a segment
+// binding, by default the one of the OZ kernel : segment 0 (0000-1FFF) and
+// segment 3 on bank 00, segment 2 on bank 01, segment 1 unbound. The OZ
+// call table at FF00 is traced as well. Targets in unbound segments are
+// listed in the header of their bank.
+//
+// Usage :
+//   ./z88_romdasm +rom=<file> [+out=<file>] [+idx=<file>] [+entry=<file>]
+//                 [+org=<bank>:<addr>,...] [+seg=<seg>:<bank>|-,...] [+jobs=<num>]
+//
+// Entry file lines (hexadecimal, '#' starts a comment) :
+//   BB:XXXX          code entry point at logical address XXXX in bank BB
+//   BB:XXXX-YYYY jp  table of "JP nn" entries (OZ call tables)
+//   BB:XXXX-YYYY dw  table of 16-bit code addresses
+
+#include "z80ex_dasm.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+
+#define ROM_SIZE      (1<<22)
+#define BANK_SIZE     (1<<14)
+
+// Byte classification
+#define F_CODE        0x01 // Part of an instruction
+#define F_HEAD        0x02 // First byte of an instruction
+#define F_LABEL       0x04 // Jump/call target or entry point
+#define F_INLINE      0x08 // RST parameter (FPP, OZ call)
+
+// Control flow
+#define FLOW_CONT     0x01 // Falls through to the next instruction
+#define FLOW_TGT      0x02 // Has a branch target
+
+struct Bank
+{
+    Z80EX_WORD       org;               // Logical address of offset 0
+    Z80EX_BYTE       flags[BANK_SIZE];  // Byte classification
+    std::vector<int> todo;              // Offsets still to be traced
+    std::vector<int> xref;              // References into other banks (bank << 14 | offset)
+    std::vector<unsigned> unres;        // Targets in unbound segments (source offset << 16 | address)
+    std::string      listing;           // Text output
+    bool             dirty;             // Needs (re)tracing
+};
+
+Z80EX_BYTE *ROM;
+size_t rom_size;
+int num_banks;
+std::vector<Bank> banks;
+
+// Bank bound to each segment, -1 : unbound (default : OZ kernel)
+int seg_bank[4] = { 0x00, -1, 0x01, 0x00 };
+
+// Command line : +<name>=<value>
+static const char *plus_arg(int argc, char **argv, const char *name)
+{
+    size_t len = strlen(name);
+
+    for (int i = 1; i < argc; i++)
+    {
+        if ((argv[i][0] == '+') && (!strncmp(argv[i] + 1, name, len)))
+            return argv[i] + 1 + len;
+    }
+    return NULL;
+}
+
+static inline Z80EX_BYTE rom_byte(int bank, int offs)
+{
+    return ROM[((size_t)bank << 14) | (offs & (BANK_SIZE-1))];
+}
+
+// z80ex_dasm callback : the bank number selects the ROM bank
+Z80EX_BYTE rom_readbyte(Z80EX_WORD addr, Z80EX_BYTE bank)
+{
+    return rom_byte(bank, addr - banks[bank].org);
+}
+
+// Control flow of the instruction at "pc"
+static int flow_decode(int bank, Z80EX_WORD pc, Z80EX_WORD *tgt, int *inl)
+{
+    Z80EX_BYTE b0 = rom_readbyte(pc, bank);
+    Z80EX_BYTE b1 = rom_readbyte(pc + 1, bank);
+    Z80EX_WORD nn = b1 | (rom_readbyte(pc + 2, bank) << 8);
+
+    *inl = 0;
+
+    switch (b0)
+    {
+        case 0xC3: { *tgt = nn; return FLOW_TGT; }                           // JP nn
+        case 0xCD: { *tgt = nn; return FLOW_TGT | FLOW_CONT; }               // CALL nn
+        case 0x18: { *tgt = pc + 2 + (signed char)b1; return FLOW_TGT; }     // JR e
+        case 0x10:                                                           // DJNZ e
+        case 0x20:                                                           // JR cc,e
+        case 0x28:
+        case 0x30:
+        case 0x38: { *tgt = pc + 2 + (signed char)b1; return FLOW_TGT | FLOW_CONT; }
+        case 0xC9: return 0;                                                 // RET
+        case 0xE9: return 0;                                                 // JP (HL)
+        case 0xDD:
+        case 0xFD: return (b1 == 0xE9) ? 0 : FLOW_CONT;                      // JP (IX/IY)
+        case 0xED: return ((b1 & 0xC7) == 0x45) ? 0 : FLOW_CONT;             // RETN, RETI
+        default: break;
+    }
+
+    switch (b0 & 0xC7)
+    {
+        case 0xC2: { *tgt = nn; return FLOW_TGT | FLOW_CONT; }               // JP cc,nn
+        case 0xC4: { *tgt = nn; return FLOW_TGT | FLOW_CONT; }               // CALL cc,nn
+        case 0xC0: return FLOW_CONT;                                         // RET cc
+        case 0xC7:                                                           // RST n
+        {
+            *tgt = b0 & 0x38;
+            // RST 00h : reset, never returns
+            if (*tgt == 0x00) return FLOW_TGT;
+            // RST 18h : FPP call, 1 parameter byte
+            if (*tgt == 0x18) *inl = 1;
+            // RST 20h : OZ call, 2 parameter bytes for $06, $09, $0C prefixes
+            if (*tgt == 0x20) *inl = (b1 == 0x06 || b1 == 0x09 || b1 == 0x0C) ? 2 : 1;
+            return FLOW_TGT | FLOW_CONT;
+        }
+        default: break;
+    }
+    return FLOW_CONT;
+}
+
+// Queue a bank offset for tracing
+static void add_offset(Bank &b, int offs)
+{
+    b.flags[offs] |= F_LABEL;
+    if (!(b.flags[offs] & F_HEAD)) b.todo.push_back(offs);
+}
+
+// Queue a logical address for tracing in "bank", or in the bank bound to its segment
+// "from" : offset of the referencing instruction, -1 for entry points
+static void add_target(int bank, Z80EX_WORD addr, int from = -1)
+{
+    Bank &b = banks[bank];
+    Z80EX_WORD offs = addr - b.org;
+    int seg = addr >> 14;
+    // Segment 0 : only the lower 8 KB are a ROM bank
+    int dst = ((seg == 0) && (addr >= 0x2000)) ? -1 : seg_bank[seg];
+
+    if (offs < BANK_SIZE)
+    {
+        add_offset(b, offs);
+    }
+    else if ((dst >= 0) && (dst < num_banks))
+    {
+        b.xref.push_back((dst << 14) | (addr & (BANK_SIZE-1)));
+    }
+    else
+    {
+        b.unres.push_back(((unsigned)(from & 0xFFFF) << 16) | addr);
+    }
+}
+
+// Recursive descent over one bank
+static void trace_bank(int bank)
+{
+    Bank &b = banks[bank];
+    char disas_out[256];
+    int t_states, t_states2;
+
+    while (!b.todo.empty())
+    {
+        int offs = b.todo.back();
+        b.todo.pop_back();
+
+        while ((offs < BANK_SIZE) && !(b.flags[offs] & F_HEAD))
+        {
+            Z80EX_WORD pc = b.org + offs;
+            Z80EX_WORD tgt = 0;
+            int inl;
+            int len = z80ex_dasm(disas_out, 256, 0, &t_states, &t_states2, rom_readbyte, pc, bank);
+            int flow = flow_decode(bank, pc, &tgt, &inl);
+
+            b.flags[offs] |= F_HEAD;
+            for (int i = 0; i < len + inl && offs + i < BANK_SIZE; i++)
+            {
+                b.flags[offs + i] |= (i < len) ? F_CODE : F_CODE | F_INLINE;
+            }
+            if (flow & FLOW_TGT) add_target(bank, tgt, offs);
+            if (!(flow & FLOW_CONT)) break;
+            offs += len + inl;
+        }
+    }
+}
+
+// Text listing of one bank
+static void list_bank(int bank)
+{
+    Bank &b = banks[bank];
+    char disas_out[256];
+    char line[320];
+    int t_states, t_states2;
+    int offs = 0;
+
+    sprintf(line, "\n; Bank %02X, origin %04X\n\n", bank, b.org);
+    b.listing = line;
+
+    // Targets in unbound segments
+    std::sort(b.unres.begin(), b.unres.end());
+    for (size_t i = 0; i < b.unres.size(); i++)
+    {
+        if ((b.unres[i] >> 16) == 0xFFFF)
+            sprintf(line, "; Unresolved target %04X from entry points\n", b.unres[i] & 0xFFFF);
+        else
+            sprintf(line, "; Unresolved target %04X from %02X:%04X\n", b.unres[i] & 0xFFFF, bank, b.unres[i] >> 16);
+        b.listing += line;
+    }
+    if (!b.unres.empty()) b.listing += "\n";
+
+    while (offs < BANK_SIZE)
+    {
+        Z80EX_WORD pc = b.org + offs;
+        char mark = (b.flags[offs] & F_LABEL) ? '*' : ' ';
+        int n, len;
+
+        if (b.flags[offs] & F_HEAD)
+        {
+            len = z80ex_dasm(disas_out, 256, 0, &t_states, &t_states2, rom_readbyte, pc, bank);
+            // Inline RST parameters
+            while ((offs + len < BANK_SIZE) && (b.flags[offs + len] & F_INLINE)) len++;
+            n = sprintf(line, "%02X:%04X %c %04X  ", bank, offs, mark, pc);
+            for (int i = 0; i < 4; i++)
+            {
+                if (i < len)
+                    n += sprintf(line + n, "%02X ", rom_byte(bank, offs + i));
+                else
+                    n += sprintf(line + n, "   ");
+            }
+            sprintf(line + n, " %s\n", disas_out);
+        }
+        else
+        {
+            // Data : up to 8 bytes, stop at the next instruction
+            len = 0;
+            n = sprintf(line, "%02X:%04X %c %04X  DEFB ", bank, offs, mark, pc);
+            do
+            {
+                n += sprintf(line + n, (len) ? ",#%02X" : "#%02X", rom_byte(bank, offs + len));
+                len++;
+            } while ((len < 8) && (offs + len < BANK_SIZE) && !(b.flags[offs + len] & F_CODE));
+            sprintf(line + n, "\n");
+        }
+        b.listing += line;
+        offs += len;
+    }
+}
+
+// Run "func" on every (dirty) bank, spread across "jobs" threads
+static void run_parallel(int jobs, void (*func)(int), bool dirty_only)
+{
+    std::atomic<int> next(0);
+    std::vector<std::thread> pool;
+
+    for (int j = 0; j < jobs; j++)
+    {
+        pool.push_back(std::thread([&]()
+        {
+            int bank;
+            while ((bank = next++) < num_banks)
+            {
+                if (!dirty_only || banks[bank].dirty) func(bank);
+            }
+        }));
+    }
+    for (size_t j = 0; j < pool.size(); j++) pool[j].join();
+}
+
+// "BB:XXXX" -> bank, logical address
+static bool parse_key(const char *s, int *bank, int *addr)
+{
+    return sscanf(s, "%x:%x", bank, addr) == 2 && *bank < num_banks;
+}
+
+static void load_entries(const char *file_name)
+{
+    FILE *fh = fopen(file_name, "r");
+    char line[256];
+
+    if (fh == NULL)
+    {
+        printf("Cannot open entry file \"%s\".\n", file_name);
+        exit(-1);
+    }
+    while (fgets(line, sizeof(line), fh))
+    {
+        char kind[8] = "";
+        int bank, beg, end;
+
+        if (strchr(line, '#')) *strchr(line, '#') = '\0';
+        if (sscanf(line, "%x:%x-%x %7s", &bank, &beg, &end, kind) == 4 && bank < num_banks)
+        {
+            int step = (!strcmp(kind, "jp")) ? 3 : 2;
+            for (int a = beg; a + step - 1 <= end; a += step)
+            {
+                int p = (step == 3) ? a + 1 : a;
+                add_target(bank, rom_readbyte(p, bank) | (rom_readbyte(p + 1, bank) << 8));
+            }
+        }
+        else if (parse_key(line, &bank, &beg))
+        {
+            add_target(bank, beg);
+        }
+    }
+    fclose(fh);
+}
+
+int main(int argc, char **argv)
+{
+    const char *arg;
+    int jobs = std::thread::hardware_concurrency();
+
+    arg = plus_arg(argc, argv, "rom=");
+    if (arg == NULL)
+    {
+        printf("Usage : %s +rom=<file> [+out=<file>] [+idx=<file>] [+entry=<file>] [+org=BB:XXXX,...] [+seg=S:BB|-,...] [+jobs=<num>]\n", argv[0]);
+        exit(-1);
+    }
+
+    // Load the ROM file
+    ROM = new Z80EX_BYTE[ROM_SIZE];
+    FILE *rom = fopen(arg, "rb");
+    if (rom == NULL) {
+      printf("Cannot open ROM file for reading.\n");
+      exit(-1);
+    }
+    rom_size = fread(ROM, 1, ROM_SIZE, rom);
+    fclose(rom);
+    printf("Loaded %ld bytes from ROM file.\n", rom_size);
+    int rom_shift = 14;
+    while( ((size_t)1 << rom_shift) < rom_size )
+      rom_shift++;
+    if ( ((size_t)1 << rom_shift) != rom_size ) {
+      memset(ROM + rom_size, 0xFF, (1 << rom_shift) - rom_size);
+      rom_size = 1 << rom_shift;
+      printf("ROM file packed into a %lu-bytes ROM.\n", rom_size);
+    }
+    num_banks = rom_size >> 14;
+
+    // Segment binding : "S:BB", or "S:-" to unbind
+    arg = plus_arg(argc, argv, "seg=");
+    while (arg && *arg)
+    {
+        int seg, bank;
+        if ((sscanf(arg, "%d:%x", &seg, &bank) == 2) && (seg >= 0) && (seg < 4)) seg_bank[seg] = bank;
+        else if ((sscanf(arg, "%d:", &seg) == 1) && (seg >= 0) && (seg < 4) && (arg[2] == '-')) seg_bank[seg] = -1;
+        arg = strchr(arg, ',');
+        if (arg) arg++;
+    }
+
+    // Bank origins : bank 00 in segment 0, banks bound to segment 1 or 2 there, others in segment 3
+    banks.resize(num_banks);
+    for (int i = 0; i < num_banks; i++)
+    {
+        memset(banks[i].flags, 0, BANK_SIZE);
+        banks[i].org   = (i) ? 0xC000 : 0x0000;
+        banks[i].dirty = true;
+    }
+    for (int seg = 2; seg >= 1; seg--)
+    {
+        if ((seg_bank[seg] > 0) && (seg_bank[seg] < num_banks)) banks[seg_bank[seg]].org = seg << 14;
+    }
+    arg = plus_arg(argc, argv, "org=");
+    while (arg && *arg)
+    {
+        int bank, addr;
+        if (parse_key(arg, &bank, &addr)) banks[bank].org = addr & 0xC000;
+        arg = strchr(arg, ',');
+        if (arg) arg++;
+    }
+
+    // Entry points : RST vectors and NMI
+    for (int v = 0x00; v <= 0x38; v += 0x08) add_target(0, v);
+    add_target(0, 0x0066);
+    // OZ call table (RST 20h dispatch) : "JP nn" entries at FF00
+    if (seg_bank[3] >= 0 && seg_bank[3] < num_banks)
+    {
+        for (int a = 0xFF00; (a <= 0xFFFD) && (rom_byte(seg_bank[3], a) == 0xC3); a += 3)
+        {
+            add_target(0, a);
+        }
+    }
+    // User tables
+    arg = plus_arg(argc, argv, "entry=");
+    if (arg) load_entries(arg);
+
+    arg = plus_arg(argc, argv, "jobs=");
+    if (arg) jobs = atoi(arg);
+    if (jobs < 1) jobs = 1;
+    printf("Tracing %d banks on %d threads.\n", num_banks, jobs);
+
+    // Trace until no bank gets new entry points from other banks
+    for (int pass = 1; ; pass++)
+    {
+        bool more = false;
+
+        // Entry points given in other segments
+        for (int i = 0; i < num_banks; i++)
+        {
+            for (size_t j = 0; j < banks[i].xref.size(); j++)
+            {
+                add_offset(banks[banks[i].xref[j] >> 14], banks[i].xref[j] & (BANK_SIZE-1));
+            }
+            banks[i].xref.clear();
+        }
+        for (int i = 0; i < num_banks; i++)
+        {
+            banks[i].dirty = !banks[i].todo.empty();
+            more |= banks[i].dirty;
+        }
+        if (!more)
+        {
+            printf("Done after %d pass(es).\n", pass - 1);
+            break;
+        }
+
+        run_parallel(jobs, trace_bank, true);
+    }
+
+    run_parallel(jobs, list_bank, false);
+
+    // Listing, indexed by bank
+    arg = plus_arg(argc, argv, "out=");
+    FILE *out = fopen((arg) ? arg : "z88_rom.lst", "wb");
+    if (out == NULL)
+    {
+        printf("Cannot create listing file \"%s\".\n", (arg) ? arg : "z88_rom.lst");
+        exit(-1);
+    }
+    arg = plus_arg(argc, argv, "idx=");
+    FILE *idx = (arg) ? fopen(arg, "wb") : NULL;
+    if ((arg) && (idx == NULL))
+    {
+        printf("Cannot create index file \"%s\".\n", arg);
+        exit(-1);
+    }
+    size_t pos = 0;
+    size_t code = 0;
+    size_t unres = 0;
+
+    for (int i = 0; i < num_banks; i++)
+    {
+        if (idx) fprintf(idx, "%02X %lu\n", i, pos);
+        fwrite(banks[i].listing.data(), 1, banks[i].listing.size(), out);
+        pos += banks[i].listing.size();
+        unres += banks[i].unres.size();
+        for (int j = 0; j < BANK_SIZE; j++)
+        {
+            if (banks[i].flags[j] & F_CODE) code++;
+        }
+    }
+    fclose(out);
+    if (idx) fclose(idx);
+
+    printf("%lu code bytes, %lu data bytes.\n", code, rom_size - code);
+    if (unres) printf("%lu target(s) in unbound segments, listed in the bank headers.\n", unres);
+
+    exit(0);
+}
@@ -10,6 +10,8 @@ module z88_screen
     input           z80_io_wr,    // Z80 I/O write
     input    [15:0] z80_addr,     // Z80 address bus
     input     [7:0] z80_wdata,    // Z80 data bus (write)
+    input           cpu_wr,       // Z80 memory write (attribute cache)
+    input    [21:0] cpu_addr,     // 4 MB address space (attribute cache)
 
     // LCD control
     input           new_fr_tgl,   // Fetch a new frame (toggle)
@@ -25,6 +27,10 @@ module z88_screen
 );
     // Blinking effect half period
     parameter BLINK_PERIOD = 30;
+    // Attribute cache (1 : enabled)
+    parameter ATTR_CACHE   = 0;
+    // Internal RAM address mask (aliases of the screen file)
+    parameter RAM_MASK     = 32'h0007FFFF;
 
     // ========================================================================
     // LCD Registers Write
@@ -140,12 +146,82 @@ module z88_screen
         end
     end
 
+    // ========================================================================
+    // LCD attribute cache
+    // ========================================================================
+
+    // The attributes of the 8 character rows are kept in a block RAM : the
+    // SBA bytes of a character row are read from the screen file on one of
+    // its pixel rows, the other ones (and the next frames) read the cache.
+    // A Z80 write into the screen file (RAM aliases included) marks its
+    // character row as dirty, a new SBR marks them all. The hit or fill of
+    // a pixel row is decided at its start : the LCD windows of the cached
+    // SBA reads have no bus cycle (lent to the Z80 with BUS_ARB).
+
+    reg [13:0] r_atc_mem [0:1023]; // Attributes (8 rows x 128 columns)
+    reg [13:0] r_atc_q;            // Cached attributes of the column
+    reg  [7:0] r_atc_vld;          // Character rows up to date
+    reg        r_atc_hit;          // Pixel row attributes read from the cache
+    reg        r_atc_upd;          // Pixel row fills the cache (no write since)
+    wire [9:0] w_atc_idx;          // Character row, column
+    wire       w_atc_sbr;          // SBR write
+    wire       w_atc_scr;          // Screen file write
+    wire [7:0] w_atc_inv;          // Dirty character rows
+    wire       w_lcd_nrow;         // Next pixel row
+
+    localparam [10:0] ATC_MASK = { 3'b111, RAM_MASK[18:11] };
+
+    assign w_atc_idx  = { r_row_ctr[5:3], r_col_ctr[6:0] };
+    assign w_atc_sbr  = z80_io_wr & clk_ena & bus_ph & (z80_addr[7:0] == 8'h74);
+    assign w_atc_scr  = cpu_wr & (((cpu_addr[21:11] ^ r_SBR) & ATC_MASK) == 11'd0);
+    assign w_atc_inv  = {8{w_atc_sbr}} | {8{w_atc_scr}} & (8'd1 << cpu_addr[10:8]);
+    assign w_lcd_nrow = clk_ena & bus_ph & r_lcd_run & r_lcd_cyc[2] & r_lcd_eol;
+
+    always @(posedge clk) begin : LCD_ATTR_RAM
+
+        if ((ATTR_CACHE != 0) & lcd_vld & r_lcd_cyc[1]) begin
+            r_atc_mem[w_atc_idx] <= { lcd_rdata[5:0], r_SBA[7:0] };
+        end
+        r_atc_q <= r_atc_mem[w_atc_idx];
+    end
+
+    always @(posedge rst or posedge clk) begin : LCD_ATTR_CTRL
+        reg [7:0] v_vld;
+        reg [5:0] v_row;
+
+        if (rst) begin
+            r_atc_vld <= 8'h00;
+            r_atc_hit <= 1'b0;
+            r_atc_upd <= 1'b0;
+        end
+        else if (ATTR_CACHE != 0) begin
+            v_vld = r_atc_vld;
+            v_row = r_row_ctr;
+            // End of a filling pixel row : character row up to date
+            if (w_lcd_nrow) begin
+                if (r_atc_upd) v_vld[r_row_ctr[5:3]] = 1'b1;
+                v_row = r_row_ctr + 6'd1;
+            end
+            v_vld = v_vld & ~w_atc_inv;
+            // Pixel row start (or LCD stopped) : hit or fill
+            if (w_lcd_nrow | ~r_lcd_run) begin
+                r_atc_hit <=  v_vld[v_row[5:3]];
+                r_atc_upd <= ~v_vld[v_row[5:3]];
+            end
+            else if (w_atc_inv[r_row_ctr[5:3]]) begin
+                r_atc_upd <= 1'b0;
+            end
+            r_atc_vld <= v_vld;
+        end
+    end
+
     // ========================================================================
     // LCD address generator
     // ========================================================================
 
     reg [21:0] r_lcd_addr; // 4 MB address space
     reg [21:9] r_pix_page; // Character pixel page
+    wire       w_lcd_rden; // LCD bus cycle
 
 
     always @(posedge rst or posedge clk) begin : PIX_PAGE_GEN
@@ -175,7 +251,7 @@ module z88_screen
     always @(*) begin : LCD_ADDR_GEN
 
         // Address generation
-        if (~bus_ph & r_lcd_run) begin
+        if (~bus_ph & w_lcd_rden) begin
             r_lcd_addr =
                 // Read SBA LSB
                 {22{r_lcd_cyc[0]}} & { r_SBR[10:0], r_row_ctr[5:3], r_col_ctr[6:0], 1'b0 } |
@@ -189,8 +265,10 @@ module z88_screen
         end
     end
 
-    assign lcd_rden = r_lcd_run;
-    assign lcd_addr = r_lcd_addr;
+    // No bus cycle for the cached SBA reads
+    assign w_lcd_rden = r_lcd_run & ~(r_atc_hit & ~r_lcd_cyc[2]);
+    assign lcd_rden   = w_lcd_rden;
+    assign lcd_addr   = r_lcd_addr;
 
     // ========================================================================
     // LCD data
@@ -225,6 +303,10 @@ module z88_screen
             if (lcd_vld & r_lcd_cyc[1]) begin
                 r_SBA[13:8] <= lcd_rdata[5:0];
             end
+            // Read SBA from the attribute cache
+            if (r_atc_hit & r_lcd_cyc[1]) begin
+                r_SBA <= r_atc_q;
+            end
             // Read Pixels
             if (lcd_vld & r_lcd_cyc[2]) begin
                 r_gfx_p0[7:0] <= lcd_rdata[7:0];
@@ -0,0 +1,187 @@
+// Symbol table for disassembly annotation
+//
+// Symbols are kept sorted by bank:address key. The keys are then laid out in
+// Eytzinger (BFS) order so that a lookup walks the array top-down with good
+// cache locality. Consecutive lookups usually hit the same symbol (the traced
+// PC moves forward), so the last match is cached as a key range.
+
+#include "z88_sym.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+struct Symbol
+{
+    unsigned key;   // bank << 16 | logical address (bank 0x100 : any bank)
+    unsigned name;  // Offset in the names pool
+};
+
+struct SymHit
+{
+    unsigned lo;    // First key covered by the symbol
+    unsigned hi;    // First key not covered
+    int      pos;   // Index in sym_tab
+};
+
+static std::vector<Symbol>   sym_tab;  // Sorted by key
+static std::string           sym_pool; // Zero terminated names
+static std::vector<unsigned> eyt_key;  // Eytzinger layout (1-based)
+static std::vector<int>      eyt_pos;  // Index in sym_tab for each node
+
+static SymHit hit_bank = { 1, 0, -1 }; // Last lookup in a given bank
+static SymHit hit_any  = { 1, 0, -1 }; // Last lookup in "any bank"
+
+static bool sym_less(const Symbol &a, const Symbol &b)
+{
+    return a.key < b.key;
+}
+
+static bool sym_same(const Symbol &a, const Symbol &b)
+{
+    return a.key == b.key;
+}
+
+int sym_load(const char *file_name)
+{
+    FILE *fh = fopen(file_name, "r");
+    char line[256];
+    int num = 0;
+
+    if (fh == NULL)
+    {
+        printf("Cannot open symbol file \"%s\".\n", file_name);
+        return 0;
+    }
+    while (fgets(line, sizeof(line), fh))
+    {
+        char name[128];
+        char value[32];
+        char *digits;
+        Symbol sym;
+
+        if (strchr(line, ';')) *strchr(line, ';') = '\0';
+        if (sscanf(line, " %127[^= \t] = %31s", name, value) != 2) continue;
+
+        digits = value;
+        if (*digits == '$') digits++;
+        else if (!strncmp(digits, "0x", 2)) digits += 2;
+
+        sym.key  = strtoul(digits, NULL, 16) & 0xFFFFFF;
+        sym.name = sym_pool.size();
+        // 16-bit value : no bank given
+        if (strlen(digits) <= 4) sym.key |= SYM_ANY_BANK << 16;
+
+        sym_pool.append(name);
+        sym_pool.push_back('\0');
+        sym_tab.push_back(sym);
+        num++;
+    }
+    fclose(fh);
+    printf("Loaded %d symbols from \"%s\".\n", num, file_name);
+    return num;
+}
+
+static void eyt_build(size_t &i, size_t k)
+{
+    if (k <= sym_tab.size())
+    {
+        eyt_build(i, 2 * k);
+        eyt_key[k] = sym_tab[i].key;
+        eyt_pos[k] = i++;
+        eyt_build(i, 2 * k + 1);
+    }
+}
+
+void sym_index(void)
+{
+    size_t i = 0;
+
+    // First definition wins
+    std::stable_sort(sym_tab.begin(), sym_tab.end(), sym_less);
+    sym_tab.erase(std::unique(sym_tab.begin(), sym_tab.end(), sym_same), sym_tab.end());
+
+    eyt_key.assign(sym_tab.size() + 1, 0);
+    eyt_pos.assign(sym_tab.size() + 1, 0);
+    eyt_build(i, 1);
+
+    hit_bank.lo = hit_any.lo = 1;
+    hit_bank.hi = hit_any.hi = 0;
+}
+
+int sym_count(void)
+{
+    return sym_tab.size();
+}
+
+// Index of the last symbol with key <= q, -1 if none
+static int sym_search(unsigned q)
+{
+    size_t n = sym_tab.size();
+    size_t k = 1;
+
+    while (k <= n)
+    {
+        k = 2 * k + (eyt_key[k] <= q);
+    }
+    // Cancel the right turns : k is the first node with key > q
+    k >>= __builtin_ffsl(~k);
+
+    return ((k) ? eyt_pos[k] : (int)n) - 1;
+}
+
+static int sym_find(unsigned q, SymHit &hit)
+{
+    int pos, nxt;
+
+    if ((q >= hit.lo) && (q < hit.hi)) return hit.pos;
+
+    pos = sym_search(q);
+    nxt = pos + 1;
+    // Only symbols of the same bank are relevant
+    if ((pos < 0) || ((sym_tab[pos].key ^ q) >> 16)) pos = -1;
+
+    hit.pos = pos;
+    hit.lo  = (pos < 0) ? q & ~0xFFFFu : sym_tab[pos].key;
+    if (nxt < (int)sym_tab.size() && !((sym_tab[nxt].key ^ q) >> 16))
+        hit.hi = sym_tab[nxt].key;
+    else
+        hit.hi = (q | 0xFFFF) + 1;
+    return pos;
+}
+
+const char *sym_lookup(int bank, int addr, int *offs)
+{
+    unsigned qb = ((bank & 0xFF) << 16) | (addr & 0xFFFF);
+    unsigned qa = (SYM_ANY_BANK << 16) | (addr & 0xFFFF);
+    int pb, pa;
+
+    if (sym_tab.empty()) return NULL;
+
+    pb = sym_find(qb, hit_bank);
+    pa = sym_find(qa, hit_any);
+    // Nearest symbol, the bank one on a tie
+    if ((pb >= 0) && ((pa < 0) || (qb - sym_tab[pb].key <= qa - sym_tab[pa].key)))
+    {
+        *offs = qb - sym_tab[pb].key;
+        return sym_pool.c_str() + sym_tab[pb].name;
+    }
+    if (pa < 0) return NULL;
+    *offs = qa - sym_tab[pa].key;
+    return sym_pool.c_str() + sym_tab[pa].name;
+}
+
+int sym_format(char *out, int out_size, int bank, int addr)
+{
+    int offs;
+    const char *name = sym_lookup(bank, addr, &offs);
+
+    if (name == NULL) return 0;
+    if (offs)
+        return snprintf(out, out_size, "%s+%X", name, offs);
+    else
+        return snprintf(out, out_size, "%s", name);
+}
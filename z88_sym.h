@@ -0,0 +1,29 @@
+// Symbol table for disassembly annotation
+//
+// Map file lines : <name> = $<value> [; comment]
+//   $BBXXXX : bank BB, logical address XXXX (same key as the DASM logs)
+//   $XXXX   : logical address XXXX in any bank
+
+#ifndef _Z88_SYM_H_INCLUDED
+#define _Z88_SYM_H_INCLUDED
+
+// Bank number for symbols without bank (out of the 00 - FF banks range)
+#define SYM_ANY_BANK  0x100
+
+// Load a map file (can be called several times), returns the number of symbols read
+extern int sym_load(const char *file_name);
+
+// Build the search index, must be called once after the last sym_load()
+extern void sym_index(void);
+
+// Number of indexed symbols
+extern int sym_count(void);
+
+// Closest symbol at or below bank:addr, in the same bank or in any bank
+// (the bank one on a tie), NULL if none
+extern const char *sym_lookup(int bank, int addr, int *offs);
+
+// Writes "name" or "name+offs" into "out", returns the length (0 if no symbol)
+extern int sym_format(char *out, int out_size, int bank, int addr);
+
+#endif
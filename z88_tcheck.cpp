@@ -0,0 +1,232 @@
+// Timing check : T-states of each Z80 instruction against the Z80 timing
+
+#include "z88_tcheck.h"
+#include "z88_probe.h"
+#include "z80ex_dasm.h"
+
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <vector>
+
+struct TcStat
+{
+    char     text[24];  // First instruction seen
+    int      t_std;     // Z80 T-states
+    uint64_t num;
+    uint64_t t_sum;     // Measured T-states
+    int      t_min;
+    int      t_max;
+    uint64_t bad;       // Unexpected timing
+};
+
+struct TcFail
+{
+    unsigned pc;
+    char     text[24];
+    int      t_std;
+    int      t_meas;
+};
+
+static std::map<uint32_t, TcStat> tc_stat; // Opcode (taken : bit 24)
+static std::vector<TcFail> tc_fail;         // First mismatches
+static char     tc_file[256];
+static bool     tc_on;
+static bool     tc_shrt;
+static uint64_t tc_num;         // Instructions compared
+static uint64_t tc_std;         // Z80 T-states
+static uint64_t tc_meas;        // Measured T-states
+static uint64_t tc_bad;
+// Instruction being timed
+static uint8_t  tc_op[8];       // Bytes read
+static int      tc_len;
+static int      tc_m1;          // Opcode fetches
+static unsigned tc_pc;
+static int      tc_t;           // T-states
+static int      tc_ack;         // M1 T-states without memory request
+static bool     tc_skip;        // Not compared
+
+static Z80EX_BYTE tc_readbyte(Z80EX_WORD addr, Z80EX_BYTE bank)
+{
+    int i = (addr - tc_pc) & 0xFFFF;
+
+    (void)bank;
+    return (i < tc_len) ? tc_op[i] : 0x00;
+}
+
+static bool tc_prefix(uint8_t op)
+{
+    return (op == 0xCB) || (op == 0xDD) || (op == 0xED) || (op == 0xFD);
+}
+
+bool tc_open(const char *file_name, bool shrt)
+{
+    tc_stat.clear();
+    tc_fail.clear();
+    tc_on   = false;
+    tc_num  = 0;
+    tc_std  = 0;
+    tc_meas = 0;
+    tc_bad  = 0;
+    tc_len  = 0;
+    tc_skip = true;
+    if (file_name == NULL) return true;
+
+    strncpy(tc_file, file_name, sizeof(tc_file) - 1);
+    tc_file[sizeof(tc_file) - 1] = '\0';
+    tc_on   = true;
+    tc_shrt = shrt;
+    printf("Timing check into \"%s\" (%s tv80 profile).\n", file_name, (shrt) ? "short (IX+d) / I/O" : "standard");
+    return true;
+}
+
+// Instruction done, "next" : address of the next one
+static void tc_end(unsigned next)
+{
+    char text[64];
+    int t1, t2, len, t_std;
+    bool taken;
+    uint32_t key;
+
+    if (tc_skip || (tc_len == 0)) return;
+
+    len   = z80ex_dasm(text, sizeof(text), 0, &t1, &t2, tc_readbyte, tc_pc, 0);
+    // Conditional : taken if the next instruction does not follow
+    taken = (t2 != 0) && (next != ((tc_pc + len) & 0xFFFF));
+    t_std = (taken) ? t2 : t1;
+
+    // Opcode : prefixes, opcode (after the displacement for DD CB / FD CB)
+    key = tc_op[0];
+    if (tc_prefix(tc_op[0]))
+    {
+        if (((tc_op[0] == 0xDD) || (tc_op[0] == 0xFD)) && (tc_op[1] == 0xCB))
+            key = (tc_op[0] << 16) | (0xCB << 8) | tc_op[3];
+        else
+            key = (tc_op[0] << 8) | tc_op[1];
+    }
+    if (taken) key |= 1 << 24;
+
+    TcStat &st = tc_stat[key];
+    bool ok = (tc_t == t_std) || (tc_shrt && (tc_t < t_std));
+
+    if (st.num == 0)
+    {
+        strncpy(st.text, text, sizeof(st.text) - 1);
+        st.t_std = t_std;
+        st.t_min = tc_t;
+        st.t_max = tc_t;
+    }
+    st.num++;
+    st.t_sum += tc_t;
+    if (tc_t < st.t_min) st.t_min = tc_t;
+    if (tc_t > st.t_max) st.t_max = tc_t;
+
+    tc_num++;
+    tc_std  += t_std;
+    tc_meas += tc_t;
+    if (!ok)
+    {
+        st.bad++;
+        tc_bad++;
+        if (tc_fail.size() < 64)
+        {
+            TcFail fail;
+
+            fail.pc = tc_pc;
+            strncpy(fail.text, text, sizeof(fail.text) - 1);
+            fail.text[sizeof(fail.text) - 1] = '\0';
+            fail.t_std  = t_std;
+            fail.t_meas = tc_t;
+            tc_fail.push_back(fail);
+        }
+    }
+}
+
+void tc_step(const uint32_t *prb)
+{
+    if (!tc_on || !PRB_CLK_ENA(prb)) return;
+
+    // One T-state
+    tc_t++;
+    // HALT state
+    if (!PRB_HALT_N(prb)) tc_skip = true;
+    // Interrupt acknowledge : M1 cycle without memory request after T1
+    if (!PRB_M1_N(prb) && PRB_MREQ_N(prb))
+    {
+        if (++tc_ack > 1) tc_skip = true;
+    }
+    else
+    {
+        tc_ack = 0;
+    }
+    // Memory access done (end of T2), not the NOPs of the HALT state
+    if (PRB_MREQ_N(prb) || !PRB_HALT_N(prb)) return;
+
+    if (!PRB_M1_N(prb))
+    {
+        if ((tc_m1 == 1) && (tc_len == 1) && tc_prefix(tc_op[0]))
+        {
+            // Opcode after a prefix
+            tc_m1++;
+        }
+        else
+        {
+            // Next instruction
+            tc_end(PRB_ADDR(prb));
+            tc_pc   = PRB_ADDR(prb);
+            tc_len  = 0;
+            tc_m1   = 1;
+            tc_t    = 0;
+            tc_skip = false;
+        }
+    }
+    // Instruction bytes are read before any operand (writes : not used)
+    if (tc_len < (int)sizeof(tc_op)) tc_op[tc_len++] = PRB_RDATA(prb);
+}
+
+bool tc_close(void)
+{
+    FILE *fh;
+
+    if (!tc_on) return true;
+    tc_on = false;
+
+    fh = fopen(tc_file, "w");
+    if (fh == NULL)
+    {
+        printf("Cannot create timing check \"%s\".\n", tc_file);
+        return false;
+    }
+    fprintf(fh, "# %s tv80 profile : %lu instructions, %lu T-states (Z80 : %lu), %lu mismatches\n",
+            (tc_shrt) ? "Short (IX+d) / I/O" : "Standard", (unsigned long)tc_num, (unsigned long)tc_meas,
+            (unsigned long)tc_std, (unsigned long)tc_bad);
+    fprintf(fh, "# opcode  taken  instruction             Z80  count       min  max  avg     bad\n");
+    for (std::map<uint32_t, TcStat>::const_iterator it = tc_stat.begin(); it != tc_stat.end(); ++it)
+    {
+        const TcStat &st = it->second;
+        char op[16];
+
+        if (it->first & 0xFF0000)
+            sprintf(op, "%06X", it->first & 0xFFFFFF);
+        else if (it->first & 0xFF00)
+            sprintf(op, "%04X", it->first & 0xFFFF);
+        else
+            sprintf(op, "%02X", it->first & 0xFF);
+        fprintf(fh, "%-8s  %-5s  %-22s  %3d  %10lu  %3d  %3d  %6.2f  %lu\n", op,
+                (it->first >> 24) ? "yes" : "", st.text, st.t_std, (unsigned long)st.num,
+                st.t_min, st.t_max, (double)st.t_sum / st.num, (unsigned long)st.bad);
+    }
+    for (size_t i = 0; i < tc_fail.size(); i++)
+    {
+        const TcFail &fail = tc_fail[i];
+
+        fprintf(fh, "! %04X  %-22s  Z80 %d, tv80 %d\n", fail.pc, fail.text, fail.t_std, fail.t_meas);
+    }
+    fclose(fh);
+
+    printf("\nTiming check : %lu instructions, %lu mismatches, %.1f %% of the Z80 T-states\n",
+           (unsigned long)tc_num, (unsigned long)tc_bad, (tc_std) ? 100.0 * tc_meas / tc_std : 0.0);
+    tc_stat.clear();
+    tc_fail.clear();
+    return tc_bad == 0;
+}
@@ -0,0 +1,28 @@
+// Timing check : T-states of each Z80 instruction against the Z80 timing
+//
+// Every instruction run by the tv80 is timed from the debug probe, from its
+// opcode fetch to the next one, and compared with the Z80 T-states given by
+// z80ex_dasm (branch taken or not for the conditional instructions). The
+// standard profile must match them, the short one (SHORT_IX_IO build) must
+// not be slower. HALT and the instructions followed by an interrupt acknowledge
+// are not compared.
+//
+// Report : one line per opcode (prefixes included) with the standard and
+// measured T-states, then the first mismatches.
+
+#ifndef _Z88_TCHECK_H_INCLUDED
+#define _Z88_TCHECK_H_INCLUDED
+
+#include <stdint.h>
+
+// Start checking, the report is written into a file (NULL : stop, nothing
+// written), "shrt" : short (IX+d) / I/O cycles profile
+extern bool tc_open(const char *file_name, bool shrt);
+
+// Debug probe words (see z88_probe.h), once per clock period
+extern void tc_step(const uint32_t *prb);
+
+// Write the report, false if an instruction does not have the expected timing
+extern bool tc_close(void);
+
+#endif
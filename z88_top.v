@@ -6,6 +6,7 @@ module z88_top
     output         clk_ena,
     output         bus_ph,
     input          flap_sw,  // normally closed =0, open =1
+    input          pct_trig, // PC trace trigger (switch)
 
     // Keyboard matrix
     input   [63:0] kb_matrix, // 8 x 8 keys
@@ -27,6 +28,26 @@ module z88_top
     output  [18:0] rom_addr,
     input   [15:0] rom_rdata,
 
+`ifdef verilator3
+    // Opcode injection (simulation only)
+    input   [63:0] cpu_inj,     // Bytes, first one in [7:0]
+    input    [3:0] cpu_inj_len, // 1 - 8 bytes
+    input          cpu_inj_tgl, // Toggle : injected at the next opcode fetch
+
+    // ROM cache clear (simulation only) : toggle, ROM written by the testbench
+    input          rc_clr_tgl,
+
+    // Debug probe (simulation only), see the layout at the end
+    output [607:0] dbg_probe,
+
+    // Bus tracer (simulation only) : access types passed to the testbench
+    input    [4:0] btrace,
+
+    // PC trace buffer read port (simulation only)
+    input   [15:0] pct_idx,
+    output  [23:0] pct_dat,
+`endif
+
     // VGA output
     output         vga_fr_tgl, // For debug
     output         vga_hs,
@@ -38,6 +59,74 @@ module z88_top
     //parameter RAM_ADDR_MASK  = 32'h00007FFF; //  32 KB
     parameter RAM_DATA_WIDTH = 16;
     parameter ROM_DATA_WIDTH = 8;
+    // Simulation turbo mode (set by the compile script) : the Z80 runs at
+    // every clock and waits for the bus, 0 : cycle accurate
+`ifdef Z88_TURBO
+    parameter TURBO          = `Z88_TURBO;
+`else
+    parameter TURBO          = 0;
+`endif
+    // Bus arbitration (set by the compile script) : the LCD windows are lent
+    // to the Z80 while the screen is idle, 0 : strict Z80 / LCD alternation
+`ifdef Z88_BUS_ARB
+    parameter BUS_ARB        = `Z88_BUS_ARB;
+`else
+    parameter BUS_ARB        = 0;
+`endif
+    // Prefetch buffer on the 16-bit internal RAM (see RAM_PREFETCH_BUF),
+    // set by the compile script, 0 : every Z80 read is an SRAM cycle
+`ifdef Z88_RAM_PREFETCH
+    parameter RAM_PREFETCH   = `Z88_RAM_PREFETCH;
+`else
+    parameter RAM_PREFETCH   = 0;
+`endif
+    // Cache in front of the internal ROM : 2^ROM_CACHE lines of 4 locations
+    // (see ROM_CACHE_CTRL, 1 - 16), set by the compile script, 0 : no cache
+`ifdef Z88_ROM_CACHE
+    parameter ROM_CACHE      = `Z88_ROM_CACHE;
+`else
+    parameter ROM_CACHE      = 0;
+`endif
+    // ROM banks $00 - $0F shadowed in the upper half of a 16-bit SRAM (see
+    // ROM_SHADOW_COPY), set by the compile script, 0 : ROM reads from flash
+`ifdef Z88_ROM_SHADOW
+    parameter ROM_SHADOW     = `Z88_ROM_SHADOW;
+`else
+    parameter ROM_SHADOW     = 0;
+`endif
+
+    // PC trace buffer of 2^PC_TRACE opcode fetches (see PC_TRACE_CTRL),
+    // set by the compile script, 0 : no buffer
+`ifdef Z88_PC_TRACE
+    parameter PC_TRACE       = `Z88_PC_TRACE;
+`else
+    parameter PC_TRACE       = 0;
+`endif
+    // LDIR / LDDR block move engine, enabled by the Blink (see
+    // BLOCK_MOVE_ENG), set by the compile script, 0 : no engine
+`ifdef Z88_BLOCK_MOVE
+    parameter BLOCK_MOVE     = `Z88_BLOCK_MOVE;
+`else
+    parameter BLOCK_MOVE     = 0;
+`endif
+    // Shorter (IX+d) addressing and no I/O wait state (tv80 mode 1, set by
+    // the compile script), 0 : Z80 T-states
+`ifdef Z88_SHORT_IX_IO
+    parameter SHORT_IX_IO       = `Z88_SHORT_IX_IO;
+`else
+    parameter SHORT_IX_IO       = 0;
+`endif
+    // LCD attribute cache (see z88_screen.v), set by the compile script,
+    // 0 : attributes read on every pixel row
+`ifdef Z88_ATTR_CACHE
+    parameter ATTR_CACHE     = `Z88_ATTR_CACHE;
+`else
+    parameter ATTR_CACHE     = 0;
+`endif
+
+    localparam ROM_SHD  = (ROM_SHADOW != 0) && (RAM_DATA_WIDTH == 16);
+    // The shadow ROM limits the internal RAM to 256 KB
+    localparam RAM_MASK = (ROM_SHD) ? RAM_ADDR_MASK & 32'h0003FFFF : RAM_ADDR_MASK;
 
     // ========================================================================
     // Clock and Control
@@ -66,16 +155,26 @@ module z88_top
     assign clk_ena = r_clk_ena[3];
     assign bus_ph  = r_bus_ph;
 
+    // Bus window owner : the Z80 gets the LCD windows while the screen does
+    // not fetch (frame done, LCD off : no new frame is started, or cached
+    // attributes). The screen starts and stops its fetches at the end of a
+    // Z80 window, so the owner is stable during a window.
+    wire      w_arb_lend;  // LCD window lent to the Z80
+    wire      w_cpu_win;   // Z80 window
+
+    assign w_arb_lend = (BUS_ARB != 0) & (TURBO == 0) & ~w_lcd_rden;
+    assign w_cpu_win  = r_bus_ph | w_arb_lend;
+
     // ========================================================================
     // Z80 CPU
     // ========================================================================
 
-    wire        w_z80_m1_n   /* verilator public */;
-    wire        w_z80_mreq_n /* verilator public */;
+    wire        w_z80_m1_n;
+    wire        w_z80_mreq_n;
     wire        w_z80_iorq_n;
     wire        w_z80_rd_n;
     wire        w_z80_wr_n;
-    wire        w_z80_halt_n /* verilator public */;
+    wire        w_z80_halt_n;
 
     wire        w_z80_int_n;
     wire        w_z80_nmi_n;
@@ -83,97 +182,380 @@ module z88_top
     wire [15:0] w_z80_addr;
     wire  [7:0] w_z80_wdata;
 
-    wire        w_z80_clk_ena /* verilator public */;
+    wire        w_z80_clk_ena;
     wire        w_z80_mem_rd;
     wire        w_z80_mem_wr;
     wire        w_z80_io_rd;
     wire        w_z80_io_wr;
+    wire  [7:0] w_z80_di;
+    wire [127:0] w_z80_dbg_regs;
+    wire        w_tv80_m1_n;  // tv80 outputs (the block move engine takes the bus)
+    wire        w_tv80_mreq_n;
+    wire        w_tv80_rd_n;
+    wire        w_tv80_wr_n;
+    wire [15:0] w_tv80_addr;
+    wire  [7:0] w_tv80_wdata;
+    wire        w_blk_io_rd;  // I/O seen by the Blink and the screen
+    wire        w_blk_io_wr;
+
+    // Z80 bus : tv80, or block move engine while the tv80 is frozen
+    assign w_z80_m1_n    = w_tv80_m1_n | r_bmv_run;
+    assign w_z80_mreq_n  = (r_bmv_run) ? ~r_bmv_acc : w_tv80_mreq_n;
+    assign w_z80_rd_n    = (r_bmv_run) ? ~r_bmv_acc |  r_bmv_wr : w_tv80_rd_n;
+    assign w_z80_wr_n    = (r_bmv_run) ? ~r_bmv_acc | ~r_bmv_wr : w_tv80_wr_n;
+    assign w_z80_addr    = (r_bmv_run) ? ((r_bmv_wr) ? r_bmv_dst : r_bmv_src) : w_tv80_addr;
+    assign w_z80_wdata   = (r_bmv_run) ? r_bmv_dat : w_tv80_wdata;
 
-    assign w_z80_clk_ena = r_clk_ena[3] & ~r_bus_ph;
     assign w_z80_mem_rd  = ~w_z80_mreq_n & ~w_z80_rd_n;
     assign w_z80_mem_wr  = ~w_z80_mreq_n & ~w_z80_wr_n;
     assign w_z80_io_rd   = ~w_z80_iorq_n & ~w_z80_rd_n;
     assign w_z80_io_wr   = ~w_z80_iorq_n & ~w_z80_wr_n;
 
-    tv80s the_z80
+    // Turbo mode : an access is latched by the bus at the start of a Z80
+    // window (clk_ena[1]) and completed at the end of the following LCD
+    // window, like a T2 state in the cycle accurate mode. The Z80 is frozen
+    // in between, the Blink keeps its 6.25 MHz strobes (RTC and registers).
+    reg         r_tbo_req;  // Access latched by the bus
+    reg         r_tbo_rdy;  // Access done
+    wire        w_tbo_acc;
+
+    assign w_tbo_acc = w_z80_mem_rd | w_z80_mem_wr | w_z80_io_rd | w_z80_io_wr;
+
+    always@(posedge rst or posedge clk) begin : TURBO_WAIT
+
+        if (rst) begin
+            r_tbo_req <= 1'b0;
+            r_tbo_rdy <= 1'b0;
+        end
+        else if (w_tbo_acc) begin
+            if (r_clk_ena[1] & r_bus_ph) begin
+                r_tbo_req <= 1'b1;
+            end
+            if (r_clk_ena[3] & ~r_bus_ph & r_tbo_req | r_clk_ena[2] & (r_pfb_hit | r_rc_hit)) begin
+                r_tbo_rdy <= 1'b1;
+            end
+        end
+        else begin
+            r_tbo_req <= 1'b0;
+            r_tbo_rdy <= 1'b0;
+        end
+    end
+
+    // Bus arbitration : a T-state without access ends with any lent window,
+    // an access is latched at the start of a Z80 window and completed at the
+    // end of the next window (the cycle accurate timing when nothing is lent)
+    reg         r_arb_req;  // Access latched by the bus
+    reg         r_arb_rdy;  // Data valid at the end of the window
+
+    always@(posedge rst or posedge clk) begin : BUS_ARB_WAIT
+
+        if (rst) begin
+            r_arb_req <= 1'b0;
+            r_arb_rdy <= 1'b0;
+        end
+        else if (w_tbo_acc) begin
+            if (r_clk_ena[1] & w_cpu_win) begin
+                r_arb_req <= 1'b1;
+            end
+            if (r_clk_ena[3] & r_arb_req | r_clk_ena[2] & (r_pfb_hit | r_rc_hit)) begin
+                r_arb_rdy <= 1'b1;
+            end
+        end
+        else begin
+            r_arb_req <= 1'b0;
+            r_arb_rdy <= 1'b0;
+        end
+    end
+
+    assign w_z80_clk_ena = ((TURBO   != 0) ? ~w_tbo_acc | r_tbo_rdy
+                         :  (BUS_ARB != 0) ? r_clk_ena[3] & (w_tbo_acc ? r_arb_rdy : w_arb_lend | ~r_bus_ph)
+                         :                   r_clk_ena[3] & ~r_bus_ph) & ~r_bmv_run;
+    // New Z80 access : an access is latched once, even if the next window is
+    // also a Z80 window (bus arbitration)
+    wire        w_cpu_new;
+
+    assign w_cpu_new     = w_cpu_win & ~r_arb_req;
+    // One Blink strobe per I/O access
+    assign w_blk_io_rd   = w_z80_io_rd & ((TURBO == 0) | r_tbo_req);
+    assign w_blk_io_wr   = w_z80_io_wr & ((TURBO == 0) | r_tbo_req);
+
+    // SHORT_IX_IO : tv80 mode 1 only differs from the Z80 mode by the (IX+d)
+    // addressing, the displacement read taking 4 T-states without the 5
+    // T-states address computation (not for the DD CB / FD CB instructions),
+    // and IOWait = 0 removes the I/O wait state : the other instructions
+    // keep the Z80 T-states
+    tv80s
+    #(
+        .Mode       ((SHORT_IX_IO != 0) ? 1 : 0),
+        .IOWait     ((SHORT_IX_IO != 0) ? 0 : 1)
+    )
+    the_z80
     (
-        .reset_n    (~rst),
+        .reset_n    (~rst & ~r_shd_run),
         .clk        (clk),
         .cen        (w_z80_clk_ena),
 
-        .m1_n       (w_z80_m1_n),
-        .mreq_n     (w_z80_mreq_n),
+        .m1_n       (w_tv80_m1_n),
+        .mreq_n     (w_tv80_mreq_n),
         .iorq_n     (w_z80_iorq_n),
-        .rd_n       (w_z80_rd_n),
-        .wr_n       (w_z80_wr_n),
+        .rd_n       (w_tv80_rd_n),
+        .wr_n       (w_tv80_wr_n),
         .rfsh_n     (/* open */),
         .halt_n     (w_z80_halt_n),
         .busak_n    (/* open */),
         .wait_n     (1'b1),
         .busrq_n    (1'b1),
 
-        .A          (w_z80_addr),
-        .dout       (w_z80_wdata),
-        .di         (r_z80_rdata),
+        .A          (w_tv80_addr),
+        .dout       (w_tv80_wdata),
+        .di         (w_z80_di),
 
-        .int_n      (w_z80_int_n),
-        .nmi_n      (w_z80_nmi_n)
+        .int_n      (w_z80_int_n | w_bmv_hold),
+        .nmi_n      (w_z80_nmi_n),
+
+        .dbg_regs   (w_z80_dbg_regs)
     );
 
     // ========================================================================
-    // I/O registers debug
+    // Opcode injection (simulation only)
     // ========================================================================
 
-/*
+    // The testbench hands the CPU over to loaded code : the injected bytes
+    // (e.g. LD SP,nn ; JP nn) replace the memory data from the next opcode
+    // fetch that starts an instruction, the program counter then moves on.
+
 `ifdef verilator3
-    integer _fh_io_log;
+    reg        r_inj_tgl;
+    reg        r_inj_arm;  // Waiting for an opcode fetch
+    reg  [3:0] r_inj_idx;  // Injected byte (1 - 8), 0 : none
+    reg        r_inj_rd;   // Delayed memory read
+    reg        r_inj_m1;   // Opcode fetch
+    reg  [7:0] r_inj_op;   // Data read
+    reg        r_inj_pfx;  // Last opcode was a prefix
+    wire [2:0] w_inj_sel;
+
+    always@(posedge rst or posedge clk) begin : CPU_INJ
 
-    initial begin
-        _fh_io_log = $fopen("mem_io.log", "w");
+        if (rst) begin
+            r_inj_tgl <= 1'b0;
+            r_inj_arm <= 1'b0;
+            r_inj_idx <= 4'd0;
+            r_inj_rd  <= 1'b0;
+            r_inj_m1  <= 1'b0;
+            r_inj_op  <= 8'h00;
+            r_inj_pfx <= 1'b0;
+        end
+        else begin
+            r_inj_rd <= w_z80_mem_rd;
+            if (w_z80_mem_rd) begin
+                r_inj_m1 <= ~w_z80_m1_n;
+                r_inj_op <= w_z80_di;
+            end
+            if (cpu_inj_tgl != r_inj_tgl) begin
+                r_inj_tgl <= cpu_inj_tgl;
+                r_inj_arm <= 1'b1;
+            end
+            // Start of an opcode fetch, not in HALT state nor after a prefix
+            if (w_z80_mem_rd & ~r_inj_rd & ~w_z80_m1_n & w_z80_halt_n & ~r_inj_pfx & r_inj_arm) begin
+                r_inj_arm <= 1'b0;
+                r_inj_idx <= 4'd1;
+            end
+            // End of a memory read
+            if (~w_z80_mem_rd & r_inj_rd) begin
+                if (r_inj_m1) begin
+                    r_inj_pfx <= (r_inj_op == 8'hCB) || (r_inj_op == 8'hDD) ||
+                                 (r_inj_op == 8'hED) || (r_inj_op == 8'hFD);
+                end
+                if (r_inj_idx != 4'd0) begin
+                    r_inj_idx <= (r_inj_idx == cpu_inj_len) ? 4'd0 : r_inj_idx + 4'd1;
+                end
+            end
+        end
     end
 
-    always@(posedge rst or posedge clk) begin : MEM_IO_DBG
-        reg _z80_mem_rd_d;
-        reg _z80_mem_wr_d;
-        reg _z80_io_rd_d;
-        reg _z80_io_wr_d;
+    assign w_inj_sel = r_inj_idx[2:0] - 3'd1;
+    assign w_z80_di  = (r_inj_idx != 4'd0) ? cpu_inj[{ w_inj_sel, 3'b000 } +: 8] : w_bmv_di;
+`else
+    assign w_z80_di  = w_bmv_di;
+`endif
+
+    // ========================================================================
+    // Block move engine
+    // ========================================================================
+
+    // LDIR / LDDR (ED B0 / ED B8) with BC = 0 or BC >= 4, when enabled by the
+    // Blink (ACTL bit 0) : the Z80 gets ED 00 (a NOP) and is frozen, the
+    // engine moves BC - 1 bytes like the Z80 (reads and writes through the
+    // MMU, one access per Z80 window, latched and completed like a T2 state),
+    // then the Z80 runs injected code : LD BC,1 ; LD DE,nn ; LD HL,nn ;
+    // JP <LDIR>. The Z80 moves the last byte itself, setting the flags.
+    // Interrupts wait for the end of the injected code. The source word of
+    // the 16-bit internal RAM is kept, its other byte is moved without a
+    // read cycle. BC, DE and HL are read from the tv80 register file.
+
+    reg        r_bmv_run;   // Engine on the bus, tv80 frozen
+    reg        r_bmv_dec;   // LDDR
+    reg [15:0] r_bmv_cnt;   // Bytes left
+    reg [15:0] r_bmv_src;   // HL
+    reg [15:0] r_bmv_dst;   // DE
+    reg [15:0] r_bmv_pc;    // LDIR / LDDR address
+    reg        r_bmv_acc;   // Access on the bus
+    reg        r_bmv_wr;    // Write (0 : read)
+    reg        r_bmv_lat;   // Access latched by the bus
+    reg        r_bmv_win;   // Window after the latch
+    reg  [7:0] r_bmv_dat;   // Byte moved
+    reg        r_bmv_fill;  // Source word read from the SRAM
+    reg        r_bmv_wbv;   // Source word valid
+    reg [15:1] r_bmv_wbl;   // Source word logical address
+    reg [18:1] r_bmv_wbp;   // Source word SRAM address
+    reg [15:0] r_bmv_wbd;   // Source word
+    reg  [3:0] r_bmv_idx;   // Injected byte (1 - 12), 0 : none
+    reg        r_bmv_rd;    // Delayed memory read
+    reg        r_bmv_m1;    // Delayed M1 cycle
+    reg        r_bmv_fet;   // Opcode fetch in this M1 cycle (not in HALT state)
+    reg  [7:0] r_bmv_op;    // Opcode read
+    reg        r_bmv_pg;    // Last opcode was a prefix
+    reg        r_bmv_ed;    // Last opcode was an ED prefix
+    wire [15:0] w_bmv_bc;
+    wire        w_bmv_hit;  // LDIR / LDDR fetched
+    wire        w_bmv_ram;  // Internal RAM access
+    wire        w_bmv_wbh;  // Source byte in the kept word
+    wire [95:0] w_bmv_inj;  // Injected code, first byte in [7:0]
+    wire  [3:0] w_bmv_sel;
+    wire        w_bmv_hold; // Interrupts held
+    wire  [7:0] w_bmv_di;
+
+    assign w_bmv_bc   = w_z80_dbg_regs[63:48];
+    assign w_bmv_hit  = (BLOCK_MOVE != 0) & w_blk_bmv_ena & r_bmv_ed & ~r_bmv_run & (r_bmv_idx == 4'd0)
+                      & w_z80_mem_rd & ~w_z80_m1_n & w_z80_halt_n
+                      & ((r_z80_rdata == 8'hB0) | (r_z80_rdata == 8'hB8))
+                      & ((w_bmv_bc[15:2] != 14'd0) | (w_bmv_bc == 16'd0));
+    assign w_bmv_ram  = (RAM_DATA_WIDTH == 16) & (w_cpu_phy_addr[21:19] == 3'b001);
+    assign w_bmv_wbh  = r_bmv_wbv & (r_bmv_wbl == r_bmv_src[15:1]);
+    assign w_bmv_inj  = { r_bmv_pc, 8'hC3, r_bmv_src, 8'h21, r_bmv_dst, 8'h11, 16'h0001, 8'h01 };
+    assign w_bmv_sel  = r_bmv_idx - 4'd1;
+    assign w_bmv_hold = r_bmv_run | (r_bmv_idx != 4'd0);
+    assign w_bmv_di   = (r_bmv_idx != 4'd0) ? w_bmv_inj[{ w_bmv_sel, 3'b000 } +: 8]
+                      : (w_bmv_hit)         ? 8'h00 : r_z80_rdata;
+
+    always@(posedge rst or posedge clk) begin : BLOCK_MOVE_ENG
 
         if (rst) begin
-            _z80_mem_rd_d <= 1'b0;
-            _z80_mem_wr_d <= 1'b0;
-            _z80_io_rd_d  <= 1'b0;
-            _z80_io_wr_d  <= 1'b0;
+            r_bmv_run  <= 1'b0;
+            r_bmv_dec  <= 1'b0;
+            r_bmv_cnt  <= 16'd0;
+            r_bmv_src  <= 16'h0000;
+            r_bmv_dst  <= 16'h0000;
+            r_bmv_pc   <= 16'h0000;
+            r_bmv_acc  <= 1'b0;
+            r_bmv_wr   <= 1'b0;
+            r_bmv_lat  <= 1'b0;
+            r_bmv_win  <= 1'b0;
+            r_bmv_dat  <= 8'h00;
+            r_bmv_fill <= 1'b0;
+            r_bmv_wbv  <= 1'b0;
+            r_bmv_wbl  <= 15'd0;
+            r_bmv_wbp  <= 18'd0;
+            r_bmv_wbd  <= 16'h0000;
+            r_bmv_idx  <= 4'd0;
+            r_bmv_rd   <= 1'b0;
+            r_bmv_m1   <= 1'b0;
+            r_bmv_fet  <= 1'b0;
+            r_bmv_op   <= 8'h00;
+            r_bmv_pg   <= 1'b0;
+            r_bmv_ed   <= 1'b0;
         end
         else begin
-            // Memory read
-            if (~w_z80_mem_rd & _z80_mem_rd_d & w_z80_halt_n) begin
-                $fwrite(_fh_io_log, "Mem RD %x @ %x\n", r_z80_rdata, w_z80_addr);
-                $fflush(_fh_io_log);
-            end
-            // Memory write
-            if (w_z80_mem_wr & ~_z80_mem_wr_d) begin
-                $fwrite(_fh_io_log, "Mem WR %x @ %x\n", w_z80_wdata, w_z80_addr);
-                $fflush(_fh_io_log);
-            end
-            // I/O read
-            if (~w_z80_io_rd & _z80_io_rd_d) begin
-                $fwrite(_fh_io_log, "I/O RD %x @ %x\n", r_z80_rdata, w_z80_addr);
-                $fflush(_fh_io_log);
-            end
-            // I/O write
-            if (w_z80_io_wr & ~_z80_io_wr_d) begin
-                $fwrite(_fh_io_log, "I/O WR %x @ %x\n", w_z80_wdata, w_z80_addr);
-                $fflush(_fh_io_log);
+            // Opcode fetches : ED prefix, not in a CB / DD / ED / FD page
+            r_bmv_rd <= w_z80_mem_rd;
+            r_bmv_m1 <= ~w_z80_m1_n;
+            if (~w_z80_m1_n & w_z80_mem_rd) begin
+                r_bmv_op  <= w_z80_di;
+                r_bmv_fet <= w_z80_halt_n;
+            end
+            // End of the M1 cycle (interrupt acknowledge : no fetch)
+            if (w_z80_m1_n & r_bmv_m1) begin
+                r_bmv_ed  <= r_bmv_fet & ~r_bmv_pg & (r_bmv_op == 8'hED);
+                r_bmv_pg  <= r_bmv_fet & ~r_bmv_pg & ((r_bmv_op == 8'hCB) | (r_bmv_op == 8'hDD) |
+                                                      (r_bmv_op == 8'hED) | (r_bmv_op == 8'hFD));
+                r_bmv_fet <= 1'b0;
+            end
+            // LDIR / LDDR read by the Z80 (as ED 00), frozen after this T-state
+            if (w_bmv_hit & w_z80_clk_ena) begin
+                r_bmv_run <= 1'b1;
+                r_bmv_dec <= r_z80_rdata[3];
+                r_bmv_cnt <= w_bmv_bc - 16'd1;
+                r_bmv_src <= w_z80_dbg_regs[95:80];
+                r_bmv_dst <= w_z80_dbg_regs[79:64];
+                r_bmv_pc  <= w_tv80_addr - 16'd1;
+                r_bmv_wr  <= 1'b0;
+                r_bmv_wbv <= 1'b0;
+            end
+            if (r_bmv_run) begin
+                // Next access, at the start of a window (like a T1 state)
+                if (r_clk_ena[0] & ~r_bmv_acc) begin
+                    if (r_bmv_cnt == 16'd0) begin
+                        // Moved : the Z80 loads the registers
+                        r_bmv_run <= 1'b0;
+                        r_bmv_idx <= 4'd1;
+                    end
+                    else if (~r_bmv_wr & w_bmv_wbh) begin
+                        // Source byte in the kept word
+                        r_bmv_dat <= (r_bmv_src[0]) ? r_bmv_wbd[15:8] : r_bmv_wbd[7:0];
+                        r_bmv_wr  <= 1'b1;
+                        r_bmv_acc <= 1'b1;
+                    end
+                    else begin
+                        r_bmv_acc <= 1'b1;
+                    end
+                end
+                // Access latched by the bus
+                if (r_clk_ena[1] & w_cpu_new & r_bmv_acc) begin
+                    r_bmv_lat <= 1'b1;
+                    if (~r_bmv_wr & w_bmv_ram) begin
+                        r_bmv_wbv  <= 1'b0;
+                        r_bmv_fill <= 1'b1;
+                        r_bmv_wbl  <= r_bmv_src[15:1];
+                        r_bmv_wbp  <= w_cpu_phy_addr[18:1] & RAM_MASK[18:1];
+                    end
+                    // Write into the kept word (e.g. LDIR fills)
+                    if (r_bmv_wr & w_bmv_ram & (r_bmv_wbp == (w_cpu_phy_addr[18:1] & RAM_MASK[18:1]))) begin
+                        if (w_cpu_phy_addr[0])
+                            r_bmv_wbd[15:8] <= r_bmv_dat;
+                        else
+                            r_bmv_wbd[ 7:0] <= r_bmv_dat;
+                    end
+                end
+                // SRAM word, with the data read
+                if (r_clk_ena[0] & r_bmv_fill) begin
+                    r_bmv_wbv  <= 1'b1;
+                    r_bmv_fill <= 1'b0;
+                    r_bmv_wbd  <= r_ram_rdata;
+                end
+                // End of the window after the latch : access done
+                if (r_clk_ena[3] & r_bmv_lat) begin
+                    r_bmv_win <= ~r_bmv_win;
+                    if (r_bmv_win) begin
+                        r_bmv_lat <= 1'b0;
+                        r_bmv_acc <= 1'b0;
+                        r_bmv_wr  <= ~r_bmv_wr;
+                        if (r_bmv_wr) begin
+                            r_bmv_cnt <= r_bmv_cnt - 16'd1;
+                            r_bmv_src <= (r_bmv_dec) ? r_bmv_src - 16'd1 : r_bmv_src + 16'd1;
+                            r_bmv_dst <= (r_bmv_dec) ? r_bmv_dst - 16'd1 : r_bmv_dst + 16'd1;
+                        end
+                        else begin
+                            r_bmv_dat <= r_z80_rdata;
+                        end
+                    end
+                end
+            end
+            // Injected code : next byte at the end of each memory read
+            if (~w_z80_mem_rd & r_bmv_rd & (r_bmv_idx != 4'd0)) begin
+                r_bmv_idx <= (r_bmv_idx == 4'd12) ? 4'd0 : r_bmv_idx + 4'd1;
             end
-            // Delayed controls
-            _z80_mem_rd_d <= w_z80_mem_rd;
-            _z80_mem_wr_d <= w_z80_mem_wr;
-            _z80_io_rd_d  <= w_z80_io_rd;
-            _z80_io_wr_d  <= w_z80_io_wr;
         end
     end
-`endif
-*/
 
     // ========================================================================
     // Blink gate array
@@ -184,6 +566,9 @@ module z88_top
     wire        w_blk_stby;
 
     wire [21:0] w_cpu_phy_addr;
+    wire [39:0] w_blk_mmu_regs;
+    wire [287:0] w_blk_perf_cnt;
+    wire        w_blk_bmv_ena;
 
     z88_blink the_blink
     (
@@ -191,46 +576,246 @@ module z88_top
         .clk        (clk),
         .clk_ena    (r_clk_ena[3]),
         .bus_ph     (r_bus_ph),
+        .cpu_ph     (w_cpu_win),
 
-        .z80_io_rd  (w_z80_io_rd),
-        .z80_io_wr  (w_z80_io_wr),
+        .z80_io_rd  (w_blk_io_rd),
+        .z80_io_wr  (w_blk_io_wr),
         .z80_addr   (w_z80_addr),
         .z80_wdata  (w_z80_wdata),
         .z80_rdata  (w_blk_rdata),
         .z80_hlt_n  (w_z80_halt_n),
+        .z80_cen    (w_z80_clk_ena),
+        .z80_m1_n   (w_z80_m1_n),
+        .z80_mreq_n (w_z80_mreq_n),
         .z80_int_n  (w_z80_int_n),
         .z80_nmi_n  (w_z80_nmi_n),
 
         .cpu_addr   (w_cpu_phy_addr),
         .lcd_on     (w_blk_lcd_on),
+        .lcd_rden   (w_lcd_rden),
         .stby       (w_blk_stby),
 
         .kb_matrix  (kb_matrix),
         .kbd_val    (kbd_val),
+        .mmu_regs   (w_blk_mmu_regs),
+        .perf_cnt   (w_blk_perf_cnt),
+        .bmv_ena    (w_blk_bmv_ena),
         .flap_sw    (flap_sw)
     );
 
+    // ========================================================================
+    // Bus tracer (simulation only)
+    // ========================================================================
+
+    // The Z80 accesses of the types enabled by "btrace" (bit 0 : memory read,
+    // 1 : memory write, 2 : I/O read, 3 : I/O write, 4 : opcode fetch) are
+    // passed to the testbench (z88_btrace.cpp), reads at the end of the cycle
+
+`ifdef verilator3
+    import "DPI-C" function void z88_bus_trace(input int typ, input int addr, input int phy, input int data);
+
+    always@(posedge rst or posedge clk) begin : BUS_TRACE
+        reg        _mem_rd_d;
+        reg        _mem_wr_d;
+        reg        _io_rd_d;
+        reg        _io_wr_d;
+        reg        _m1;
+        reg [15:0] _addr;
+        reg [21:0] _phy;
+        reg  [7:0] _data;
+
+        if (rst) begin
+            _mem_rd_d <= 1'b0;
+            _mem_wr_d <= 1'b0;
+            _io_rd_d  <= 1'b0;
+            _io_wr_d  <= 1'b0;
+            _m1       <= 1'b0;
+            _addr     <= 16'h0000;
+            _phy      <= 22'h000000;
+            _data     <= 8'h00;
+        end
+        else begin
+            // Reads : address and data sampled up to the end of the cycle
+            if (w_z80_mem_rd | w_z80_io_rd) begin
+                _m1   <= ~w_z80_m1_n;
+                _addr <= w_z80_addr;
+                _phy  <= w_cpu_phy_addr;
+                _data <= w_z80_di;
+            end
+            if (btrace != 5'b00000) begin
+                // Memory read / opcode fetch (not the HALT state NOPs)
+                if (~w_z80_mem_rd & _mem_rd_d & w_z80_halt_n & (_m1 ? btrace[4] : btrace[0])) begin
+                    z88_bus_trace(_m1 ? 16 : 1, { 16'd0, _addr }, { 10'd0, _phy }, { 24'd0, _data });
+                end
+                // Memory write
+                if (w_z80_mem_wr & ~_mem_wr_d & btrace[1]) begin
+                    z88_bus_trace(2, { 16'd0, w_z80_addr }, { 10'd0, w_cpu_phy_addr }, { 24'd0, w_z80_wdata });
+                end
+                // I/O read
+                if (~w_z80_io_rd & _io_rd_d & btrace[2]) begin
+                    z88_bus_trace(4, { 16'd0, _addr }, 0, { 24'd0, _data });
+                end
+                // I/O write
+                if (w_z80_io_wr & ~_io_wr_d & btrace[3]) begin
+                    z88_bus_trace(8, { 16'd0, w_z80_addr }, 0, { 24'd0, w_z80_wdata });
+                end
+            end
+            // Delayed controls
+            _mem_rd_d <= w_z80_mem_rd;
+            _mem_wr_d <= w_z80_mem_wr;
+            _io_rd_d  <= w_z80_io_rd;
+            _io_wr_d  <= w_z80_io_wr;
+        end
+    end
+`endif
+
+    // ========================================================================
+    // PC trace buffer
+    // ========================================================================
+
+    // Ring buffer (block RAM) of the last opcode fetches : bank (physical
+    // address bits 21 - 14) and PC, not the NOPs of the HALT state. A trigger
+    // freezes it, it is then read from the oldest entry. I/O ports :
+    //   $F8 : TCTL (write) : bit 0 capture, trigger on : bit 1 PC match,
+    //         bit 2 Z80 interrupt, bit 3 trigger switch (capture and switch
+    //         after reset), a write restarts the capture
+    //         TSTA (read) : bit 7 frozen, bit 6 full, bits 3 - 0 TCTL
+    //   $F9 : trigger PC LSB                $FA : trigger PC MSB
+    //   $FB : log2 of the buffer size (read)
+    //   $FC : PC LSB, $FD : PC MSB, $FE : bank (read), $FE moves to the next
+
+    localparam PCT_LINES = 1 << PC_TRACE;
+
+    reg [23:0] r_pct_mem [0:PCT_LINES-1]; // Bank, PC
+    reg [23:0] r_pct_q;     // Entry read
+    reg  [3:0] r_pct_ctl;   // TCTL
+    reg [15:0] r_pct_pc;    // Trigger PC
+    reg [15:0] r_pct_wrp;   // Next entry written
+    reg [15:0] r_pct_rdp;   // Entry read
+    reg        r_pct_full;  // All the entries written
+    reg        r_pct_frz;   // Frozen
+    reg        r_pct_int_n; // Previous Z80 interrupt
+    reg        r_pct_sw;    // Previous trigger switch
+    reg        r_pct_iord;  // Reading $FE
+    wire       w_pct_wen;   // Opcode fetch recorded
+    wire       w_pct_trg;   // Trigger
+    wire       w_pct_io;    // I/O read of the buffer ports
+    reg  [7:0] r_pct_rdata;
+    wire       w_pct_wr;    // I/O write strobe
+
+    assign w_pct_wen = (PC_TRACE != 0) & r_pct_ctl[0] & ~r_pct_frz & r_clk_ena[1] & w_cpu_new
+                     & w_z80_mem_rd & ~w_z80_m1_n & w_z80_halt_n;
+    assign w_pct_trg = r_pct_ctl[1] & w_pct_wen & (w_z80_addr == r_pct_pc)
+                     | r_pct_ctl[2] & ~w_z80_int_n & r_pct_int_n
+                     | r_pct_ctl[3] & pct_trig & ~r_pct_sw;
+    assign w_pct_io  = (PC_TRACE != 0) & (w_z80_addr[7:3] == 5'b11111);
+    assign w_pct_wr  = (PC_TRACE != 0) & w_blk_io_wr & r_clk_ena[3] & r_bus_ph;
+
+    always @(posedge clk) begin : PC_TRACE_RAM
+
+        if (w_pct_wen) begin
+            r_pct_mem[r_pct_wrp & (PCT_LINES - 1)] <= { w_cpu_phy_addr[21:14], w_z80_addr };
+        end
+        r_pct_q <= r_pct_mem[r_pct_rdp & (PCT_LINES - 1)];
+    end
+
+    always@(posedge rst or posedge clk) begin : PC_TRACE_CTRL
+
+        if (rst) begin
+            r_pct_ctl   <= 4'b1001;
+            r_pct_pc    <= 16'h0000;
+            r_pct_wrp   <= 16'd0;
+            r_pct_rdp   <= 16'd0;
+            r_pct_full  <= 1'b0;
+            r_pct_frz   <= 1'b0;
+            r_pct_int_n <= 1'b1;
+            r_pct_sw    <= 1'b0;
+            r_pct_iord  <= 1'b0;
+        end
+        else begin
+            // Opcode fetch
+            if (w_pct_wen) begin
+                r_pct_wrp <= (r_pct_wrp + 16'd1) & (PCT_LINES - 1);
+                if (r_pct_wrp == PCT_LINES - 1) r_pct_full <= 1'b1;
+            end
+            // Freeze, the oldest entry is read first
+            if (w_pct_trg & ~r_pct_frz) begin
+                r_pct_frz <= 1'b1;
+                r_pct_rdp <= (r_pct_full) ? (r_pct_wrp + { 15'd0, w_pct_wen }) & (PCT_LINES - 1) : 16'd0;
+            end
+            // I/O Registers Write
+            if (w_pct_wr) begin
+                case (w_z80_addr[7:0])
+                    8'hF8 : begin
+                        r_pct_ctl  <= w_z80_wdata[3:0];
+                        r_pct_wrp  <= 16'd0;
+                        r_pct_full <= 1'b0;
+                        r_pct_frz  <= 1'b0;
+                    end
+                    8'hF9 : r_pct_pc[ 7:0] <= w_z80_wdata;
+                    8'hFA : r_pct_pc[15:8] <= w_z80_wdata;
+                    default : ;
+                endcase
+            end
+            // Next entry, at the end of the $FE read
+            r_pct_iord <= w_z80_io_rd & (w_z80_addr[7:0] == 8'hFE);
+            if (r_pct_iord & ~w_z80_io_rd) begin
+                r_pct_rdp <= (r_pct_rdp + 16'd1) & (PCT_LINES - 1);
+            end
+            r_pct_int_n <= w_z80_int_n;
+            r_pct_sw    <= pct_trig;
+        end
+    end
+
+    always @(*) begin : PC_TRACE_RD
+
+        case (w_z80_addr[7:0])
+            8'hF8   : r_pct_rdata = { r_pct_frz, r_pct_full, 2'b00, r_pct_ctl };
+            8'hF9   : r_pct_rdata = r_pct_pc[ 7:0];
+            8'hFA   : r_pct_rdata = r_pct_pc[15:8];
+            8'hFB   : r_pct_rdata = PC_TRACE[7:0];
+            8'hFC   : r_pct_rdata = r_pct_q[ 7: 0];
+            8'hFD   : r_pct_rdata = r_pct_q[15: 8];
+            8'hFE   : r_pct_rdata = r_pct_q[23:16];
+            default : r_pct_rdata = 8'h00;
+        endcase
+    end
+
+`ifdef verilator3
+    assign pct_dat = r_pct_mem[pct_idx & (PCT_LINES - 1)];
+`endif
+
     // ========================================================================
     // 640 x 64 LCD screen
     // ========================================================================
 
     wire        w_lcd_rden;
     wire [21:0] w_lcd_phy_addr;
+    wire        w_lcd_snp_wr;   // Z80 memory write latched by the bus
+
+    wire        w_lcd_vram_we;
+    wire  [2:0] w_lcd_vram_data;
+    wire [14:0] w_lcd_vram_addr;
 
-    wire        w_lcd_vram_we /* verilator public */;
-    wire  [2:0] w_lcd_vram_data /* verilator public */;
-    wire [14:0] w_lcd_vram_addr /* verilator public */;
+    assign w_lcd_snp_wr = w_z80_mem_wr & w_cpu_new & r_clk_ena[1];
 
-    z88_screen the_screen
+    z88_screen
+    #(
+        .ATTR_CACHE (ATTR_CACHE),
+        .RAM_MASK   (RAM_MASK)
+    )
+    the_screen
     (
         .rst        (rst),
         .clk        (clk),
         .clk_ena    (r_clk_ena[3]),
         .bus_ph     (r_bus_ph),
 
-        .z80_io_wr  (w_z80_io_wr),
+        .z80_io_wr  (w_blk_io_wr),
         .z80_addr   (w_z80_addr),
         .z80_wdata  (w_z80_wdata),
+        .cpu_wr     (w_lcd_snp_wr),
+        .cpu_addr   (w_cpu_phy_addr),
 
         .new_fr_tgl (w_vga_fr_tgl),
         .lcd_rden   (w_lcd_rden),
@@ -247,7 +832,7 @@ module z88_top
     // 640 x 480 VGA output
     // ========================================================================
 
-    wire        w_vga_fr_tgl /* verilator public */;
+    wire        w_vga_fr_tgl;
 
     z88_vga the_vga
     (
@@ -269,6 +854,311 @@ module z88_top
 
     assign vga_fr_tgl = w_vga_fr_tgl;
 
+    // ========================================================================
+    // RAM prefetch buffer
+    // ========================================================================
+
+    // 16-bit internal RAM : the word of the last Z80 read is kept, a read of
+    // its other byte (e.g. the next opcode or operand) is served without an
+    // SRAM cycle. The data is ready at the end of the Z80 window : turbo and
+    // bus arbitration modes complete the access there, the cycle accurate
+    // mode keeps its timing. Dropped on memory writes and bank / COM writes.
+
+    reg        r_pfb_vld;  // Word valid
+    reg [18:1] r_pfb_tag;  // Word address
+    reg [15:0] r_pfb_data; // Word
+    reg        r_pfb_fill; // Word read from the SRAM
+    reg        r_pfb_hit;  // Z80 read served by the buffer
+    reg        r_pfb_byte; // Z80 reads LSB(0) / MSB(1)
+    wire       w_pfb_ram;  // Z80 internal RAM read
+    wire       w_pfb_hit;
+
+    assign w_pfb_ram = (RAM_PREFETCH != 0) & (RAM_DATA_WIDTH == 16) & w_z80_mem_rd
+                     & (w_cpu_phy_addr[21:19] == 3'b001) & w_cpu_new;
+    assign w_pfb_hit = w_pfb_ram & r_pfb_vld
+                     & (r_pfb_tag == (w_cpu_phy_addr[18:1] & RAM_MASK[18:1]));
+
+    always@(posedge rst or posedge clk) begin : RAM_PREFETCH_BUF
+
+        if (rst) begin
+            r_pfb_vld  <= 1'b0;
+            r_pfb_tag  <= 18'd0;
+            r_pfb_data <= 16'h0000;
+            r_pfb_fill <= 1'b0;
+            r_pfb_hit  <= 1'b0;
+            r_pfb_byte <= 1'b0;
+        end
+        else begin
+            // Z80 access latched by the bus
+            if (r_clk_ena[1]) begin
+                r_pfb_hit  <= w_pfb_hit;
+                r_pfb_byte <= w_cpu_phy_addr[0];
+                if (w_pfb_ram & ~w_pfb_hit) begin
+                    r_pfb_vld  <= 1'b0;
+                    r_pfb_fill <= 1'b1;
+                    r_pfb_tag  <= w_cpu_phy_addr[18:1] & RAM_MASK[18:1];
+                end
+            end
+            // SRAM word, with the Z80 data
+            if (r_clk_ena[0] & r_pfb_fill) begin
+                r_pfb_vld  <= 1'b1;
+                r_pfb_fill <= 1'b0;
+                r_pfb_data <= r_ram_rdata;
+            end
+            // Memory write, SR0 - SR3 or COM write
+            if (w_z80_mem_wr | w_blk_io_wr & ((w_z80_addr[7:2] == 6'b110100) | (w_z80_addr[7:0] == 8'hB0))) begin
+                r_pfb_vld  <= 1'b0;
+                r_pfb_fill <= 1'b0;
+            end
+        end
+    end
+
+    // ========================================================================
+    // ROM cache
+    // ========================================================================
+
+    // Direct mapped cache of the internal ROM (block RAM) : a line holds 4
+    // ROM locations (bytes or words, like rom_addr), its tag the address bits
+    // above the line index and a valid bit per location. A Z80 miss reads its
+    // location from the ROM, the other locations of the line are then read in
+    // the Z80 windows where the ROM is free (no access, RAM or I/O access,
+    // cache hit). The Z80 reads hitting a line take no ROM cycle, the data
+    // being ready at the end of the Z80 window : they complete one window
+    // earlier in turbo and bus arbitration modes only, the cycle accurate
+    // timing is unchanged. The LCD reads (screen, font) have fixed windows :
+    // they neither use nor fill the cache. The lines are cleared after reset,
+    // and again in simulation when the testbench writes the ROM (rc_clr_tgl).
+
+    localparam RC_LW    = 2;                      // Locations per line (log2)
+    localparam RC_LINES = 1 << ROM_CACHE;
+    localparam RC_LOCS  = RC_LINES << RC_LW;
+    localparam RC_TW    = 19 - ROM_CACHE - RC_LW; // Tag width
+
+    reg [RC_TW+3:0] r_rc_tag [0:RC_LINES-1]; // Valid locations, tag
+    reg      [15:0] r_rc_dat [0:RC_LOCS-1];  // Data
+    reg [RC_TW+3:0] r_rc_tq;     // Line of the current address
+    reg      [15:0] r_rc_dq;     // Location of the current address
+    reg             r_rc_twen;   // Tag write
+    reg      [18:0] r_rc_tidx;
+    reg [RC_TW+3:0] r_rc_twdat;
+    reg             r_rc_dwen;   // Data write
+    reg      [18:0] r_rc_didx;
+    reg      [15:0] r_rc_dwdat;
+    reg             r_rc_clr;    // Clearing the lines
+    reg             r_rc_tgl;    // Clear toggle (simulation only)
+    reg      [16:0] r_rc_line;   // Line filled (ROM address >> 2)
+    reg       [3:0] r_rc_lvld;   // Its valid locations
+    reg       [3:0] r_rc_pend;   // Its locations still to be read
+    reg       [1:0] r_rc_fill;   // ROM read : latched (0), data next window (1)
+    reg      [18:0] r_rc_fadr0;  // ROM address of these reads
+    reg      [18:0] r_rc_fadr1;
+    reg             r_rc_bgw;    // Background read in the current window
+    reg             r_rc_hit;    // Z80 read served by the cache
+    reg             r_rc_byte;   // Z80 reads LSB(0) / MSB(1)
+    reg      [31:0] r_rc_hits;   // Hit / miss counters (debug probe)
+    reg      [31:0] r_rc_miss;
+    wire     [18:0] w_rc_adr;
+    wire [RC_TW-1:0] w_rc_tagq;  // Tag of the current address
+    wire      [3:0] w_rc_loc;    // Location of the current address in its line
+    wire            w_rc_rom;    // Z80 internal ROM read
+    wire            w_rc_hit;
+    wire      [1:0] w_rc_bgsel;  // Next location read in the background
+    wire     [18:0] w_rc_bgadr;
+    wire            w_rc_bg;     // Background read in this Z80 window
+
+    assign w_rc_adr   = (ROM_DATA_WIDTH == 8) ? w_cpu_phy_addr[18:0] : { 1'b0, w_cpu_phy_addr[18:1] };
+    assign w_rc_tagq  = w_rc_adr[18:ROM_CACHE+RC_LW];
+    assign w_rc_loc   = 4'b0001 << w_rc_adr[1:0];
+    assign w_rc_rom   = (ROM_CACHE != 0) & w_z80_mem_rd & (w_cpu_phy_addr[21:19] == 3'b000)
+                      & w_cpu_new & ~r_rc_clr & ~w_shd_cpu;
+    assign w_rc_hit   = w_rc_rom & ((r_rc_tq[RC_TW+3:RC_TW] & w_rc_loc) != 4'b0000)
+                      & (r_rc_tq[RC_TW-1:0] == w_rc_tagq);
+    assign w_rc_bgsel = (r_rc_pend[0]) ? 2'd0 : (r_rc_pend[1]) ? 2'd1 : (r_rc_pend[2]) ? 2'd2 : 2'd3;
+    assign w_rc_bgadr = { r_rc_line, w_rc_bgsel };
+    // The ROM is free : no Z80 write (ROM output enable) nor ROM read
+    assign w_rc_bg    = (ROM_CACHE != 0) & w_cpu_win & (r_rc_pend != 4'b0000) & ~r_rc_clr
+                      & ~(w_cpu_new & (w_z80_mem_wr | w_rc_rom & ~w_rc_hit));
+
+    always @(posedge clk) begin : ROM_CACHE_RAM
+
+        if (r_rc_twen) begin
+            r_rc_tag[(r_rc_tidx >> RC_LW) & (RC_LINES - 1)] <= r_rc_twdat;
+        end
+        if (r_rc_dwen) begin
+            r_rc_dat[r_rc_didx & (RC_LOCS - 1)] <= r_rc_dwdat;
+        end
+        r_rc_tq <= r_rc_tag[(w_rc_adr >> RC_LW) & (RC_LINES - 1)];
+        r_rc_dq <= r_rc_dat[w_rc_adr & (RC_LOCS - 1)];
+    end
+
+    always @(posedge rst or posedge clk) begin : ROM_CACHE_CTRL
+        reg [3:0] v_vld;
+
+        if (rst) begin
+            r_rc_twen  <= 1'b0;
+            r_rc_tidx  <= 19'd0;
+            r_rc_twdat <= {(RC_TW+4){1'b0}};
+            r_rc_dwen  <= 1'b0;
+            r_rc_didx  <= 19'd0;
+            r_rc_dwdat <= 16'h0000;
+            r_rc_clr   <= 1'b1;
+            r_rc_tgl   <= 1'b0;
+            r_rc_line  <= 17'd0;
+            r_rc_lvld  <= 4'b0000;
+            r_rc_pend  <= 4'b0000;
+            r_rc_fill  <= 2'b00;
+            r_rc_fadr0 <= 19'd0;
+            r_rc_fadr1 <= 19'd0;
+            r_rc_bgw   <= 1'b0;
+            r_rc_hit   <= 1'b0;
+            r_rc_byte  <= 1'b0;
+            r_rc_hits  <= 32'd0;
+            r_rc_miss  <= 32'd0;
+        end
+        else begin
+            r_rc_twen <= 1'b0;
+            r_rc_dwen <= 1'b0;
+            if (r_rc_clr) begin
+                // Invalid lines
+                r_rc_twen  <= 1'b1;
+                r_rc_twdat <= {(RC_TW+4){1'b0}};
+                r_rc_tidx  <= r_rc_tidx + ({ 18'd0, r_rc_twen } << RC_LW);
+                r_rc_clr   <= ((r_rc_tidx >> RC_LW) != RC_LINES - 1) | ~r_rc_twen;
+                r_rc_lvld  <= 4'b0000;
+                r_rc_pend  <= 4'b0000;
+            end
+            // Z80 access latched by the bus, or background read
+            if (r_clk_ena[1]) begin
+                r_rc_hit  <= w_rc_hit;
+                r_rc_byte <= w_cpu_phy_addr[0];
+                r_rc_bgw  <= w_rc_bg;
+                if (w_rc_rom) begin
+                    if (w_rc_hit)
+                        r_rc_hits <= r_rc_hits + 32'd1;
+                    else
+                        r_rc_miss <= r_rc_miss + 32'd1;
+                end
+                if (w_rc_rom & ~w_rc_hit) begin
+                    // Miss : the Z80 read fills its location, the other
+                    // locations of the line are read in the background
+                    r_rc_fill[0] <= 1'b1;
+                    r_rc_fadr0   <= w_rc_adr;
+                    if ((w_rc_adr[18:2] == r_rc_line) && (r_rc_lvld != 4'b0000)) begin
+                        r_rc_pend <= r_rc_pend & ~w_rc_loc;
+                    end
+                    else begin
+                        v_vld      = (r_rc_tq[RC_TW-1:0] == w_rc_tagq) ? r_rc_tq[RC_TW+3:RC_TW] : 4'b0000;
+                        r_rc_line <= w_rc_adr[18:2];
+                        r_rc_lvld <= v_vld;
+                        r_rc_pend <= ~(v_vld | w_rc_loc);
+                    end
+                end
+                else if (w_rc_bg) begin
+                    r_rc_fill[0] <= 1'b1;
+                    r_rc_fadr0   <= w_rc_bgadr;
+                    r_rc_pend    <= r_rc_pend & ~(4'b0001 << w_rc_bgsel);
+                end
+            end
+            if (r_clk_ena[3]) begin
+                r_rc_fill  <= { r_rc_fill[0], 1'b0 };
+                r_rc_fadr1 <= r_rc_fadr0;
+                r_rc_bgw   <= 1'b0;
+            end
+            // ROM data (with the Z80 data for a miss), kept if its line is
+            // still the one filled
+            if (r_clk_ena[2] & r_rc_fill[1] & ~r_rc_clr & (r_rc_fadr1[18:2] == r_rc_line)) begin
+                v_vld       = r_rc_lvld | (4'b0001 << r_rc_fadr1[1:0]);
+                r_rc_lvld  <= v_vld;
+                r_rc_dwen  <= 1'b1;
+                r_rc_didx  <= r_rc_fadr1;
+                r_rc_dwdat <= r_rom_rdata;
+                r_rc_twen  <= 1'b1;
+                r_rc_tidx  <= r_rc_fadr1;
+                r_rc_twdat <= { v_vld, r_rc_fadr1[18:ROM_CACHE+RC_LW] };
+            end
+`ifdef verilator3
+            // ROM written by the testbench : clear again, no pending fill
+            if (rc_clr_tgl != r_rc_tgl) begin
+                r_rc_tgl  <= rc_clr_tgl;
+                r_rc_clr  <= 1'b1;
+                r_rc_twen <= 1'b0;
+                r_rc_dwen <= 1'b0;
+                r_rc_tidx <= 19'd0;
+                r_rc_fill <= 2'b00;
+                r_rc_lvld <= 4'b0000;
+                r_rc_pend <= 4'b0000;
+            end
+`endif
+        end
+    end
+
+    // ========================================================================
+    // ROM shadowing
+    // ========================================================================
+
+    // ROM banks $00 - $0F (256 KB) are copied from the flash into the upper
+    // half of the SRAM, the Z80 being held in reset, then the Z80 and LCD
+    // reads of these banks are SRAM reads. The copy reads the flash like the
+    // Z80 (one read per Z80 window). In simulation the testbench copies the
+    // ROM image before the run, there is no copy cycle.
+
+    reg        r_shd_run;   // Copy in progress
+    reg [18:0] r_shd_adr;   // ROM byte address
+    reg [17:1] r_shd_wadr;  // SRAM word written
+    reg [15:0] r_shd_dat;
+    reg        r_shd_rd_n;  // Flash read
+    reg        r_shd_wr_n;  // SRAM write
+    reg        r_shd_end;   // Last word written
+    wire       w_shd_cpu;   // Z80 read from the shadow ROM
+    wire       w_shd_lcd;   // LCD read from the shadow ROM
+
+    assign w_shd_cpu = (ROM_SHD != 0) & w_z80_mem_rd & (w_cpu_phy_addr[21:18] == 4'b0000) & w_cpu_win;
+    assign w_shd_lcd = (ROM_SHD != 0) & w_lcd_rden & (w_lcd_phy_addr[21:18] == 4'b0000) & ~w_cpu_win;
+
+    always@(posedge rst or posedge clk) begin : ROM_SHADOW_COPY
+
+        if (rst) begin
+`ifdef verilator3
+            r_shd_run  <= 1'b0;
+`else
+            r_shd_run  <= (ROM_SHD != 0);
+`endif
+            r_shd_adr  <= 19'd0;
+            r_shd_wadr <= 17'd0;
+            r_shd_dat  <= 16'h0000;
+            r_shd_rd_n <= 1'b1;
+            r_shd_wr_n <= 1'b1;
+            r_shd_end  <= 1'b0;
+        end
+        else if (r_shd_run) begin
+            // Z80 window : flash read, end of the SRAM write
+            if (r_clk_ena[1] & r_bus_ph) begin
+                r_shd_rd_n <= r_shd_end;
+                r_shd_wr_n <= 1'b1;
+                r_shd_run  <= ~r_shd_end;
+            end
+            // Next window : flash data, SRAM write of a complete word
+            if (r_clk_ena[2] & ~r_bus_ph & ~r_shd_rd_n) begin
+                if (ROM_DATA_WIDTH == 8) begin
+                    if (r_shd_adr[0])
+                        r_shd_dat[15:8] <= r_rom_rdata[7:0];
+                    else
+                        r_shd_dat[ 7:0] <= r_rom_rdata[7:0];
+                    r_shd_wr_n <= ~r_shd_adr[0];
+                    r_shd_adr  <= r_shd_adr + 19'd1;
+                end
+                else begin
+                    r_shd_dat  <= r_rom_rdata;
+                    r_shd_wr_n <= 1'b0;
+                    r_shd_adr  <= r_shd_adr + 19'd2;
+                end
+                r_shd_rd_n <= 1'b1;
+                r_shd_wadr <= r_shd_adr[17:1];
+                r_shd_end  <= (r_shd_adr[17:1] == 17'h1FFFF) & (r_shd_adr[0] | (ROM_DATA_WIDTH != 8));
+            end
+        end
+    end
+
     // ========================================================================
     // External memory bus
     // ========================================================================
@@ -289,7 +1179,7 @@ module z88_top
     reg [15:0] r_ram_rdata;
     reg [15:0] r_ram_wdata;
     reg [15:0] r_rom_rdata;
-    reg  [7:0] r_z80_rdata /* verilator public */;
+    reg  [7:0] r_z80_rdata;
     reg  [7:0] r_lcd_rdata;
     reg        r_lcd_vld;
 
@@ -330,22 +1220,22 @@ module z88_top
         end
         else begin
             if (r_clk_ena[1]) begin
-                if (r_bus_ph) begin
-                    // Z80 access
-                    r_ext_oe_n    <= ~w_z80_mem_rd;
+                if (w_cpu_new) begin
+                    // Z80 access, ROM cache background read
+                    r_ext_oe_n    <= ~w_z80_mem_rd & ~w_rc_bg;
                     r_ext_we_n    <= ~w_z80_mem_wr;
-                    r_rom_cs_n    <= (w_cpu_phy_addr[21:19] == 3'b000) ? w_z80_mreq_n : 1'b1;
-                    r_ram_cs_n    <= (w_cpu_phy_addr[21:19] == 3'b001) ? w_z80_mreq_n : 1'b1;
+                    r_rom_cs_n    <= ((w_cpu_phy_addr[21:19] == 3'b000) & ~w_shd_cpu ? w_z80_mreq_n | w_rc_hit : 1'b1) & ~w_rc_bg;
+                    r_ram_cs_n    <= (w_cpu_phy_addr[21:19] == 3'b001) |  w_shd_cpu ? w_z80_mreq_n | w_pfb_hit : 1'b1;
                     r_ext_cs_n[1] <= (w_cpu_phy_addr[21:20] == 2'b01 ) ? w_z80_mreq_n : 1'b1;
                     r_ext_cs_n[2] <= (w_cpu_phy_addr[21:20] == 2'b10 ) ? w_z80_mreq_n : 1'b1;
                     r_ext_cs_n[3] <= (w_cpu_phy_addr[21:20] == 2'b11 ) ? w_z80_mreq_n : 1'b1;
                 end
                 else begin
-                    // LCD access
-                    r_ext_oe_n    <= ~w_lcd_rden;
+                    // LCD access, ROM cache background read
+                    r_ext_oe_n    <= ~w_lcd_rden & ~w_rc_bg;
                     r_ext_we_n    <= 1'b1;
-                    r_rom_cs_n    <= (w_lcd_phy_addr[21:19] == 3'b000) ? ~w_lcd_rden : 1'b1;
-                    r_ram_cs_n    <= (w_lcd_phy_addr[21:19] == 3'b001) ? ~w_lcd_rden : 1'b1;
+                    r_rom_cs_n    <= ((w_lcd_phy_addr[21:19] == 3'b000) & ~w_shd_lcd ? ~w_lcd_rden : 1'b1) & ~w_rc_bg;
+                    r_ram_cs_n    <= (w_lcd_phy_addr[21:19] == 3'b001) |  w_shd_lcd ? ~w_lcd_rden : 1'b1;
                     r_ext_cs_n[1] <= (w_lcd_phy_addr[21:20] == 2'b01 ) ? ~w_lcd_rden : 1'b1;
                     r_ext_cs_n[2] <= (w_lcd_phy_addr[21:20] == 2'b10 ) ? ~w_lcd_rden : 1'b1;
                     r_ext_cs_n[3] <= (w_lcd_phy_addr[21:20] == 2'b11 ) ? ~w_lcd_rden : 1'b1;
@@ -353,9 +1243,9 @@ module z88_top
             end
             else if (r_clk_ena[3]) begin
                 // Keep track of previous bus phase access
-                if (r_bus_ph) begin
+                if (w_cpu_win) begin
                     v_cpu_ram_rd <= ~r_ram_cs_n;
-                    v_cpu_rom_rd <= ~r_rom_cs_n;
+                    v_cpu_rom_rd <= ~r_rom_cs_n & ~r_rc_bgw;
                     v_cpu_byte   <= (r_ram_cs_n) ? r_rom_be_n[0] : r_ram_be_n[0];
                     v_lcd_ram_rd <= 1'b0;
                     v_lcd_rom_rd <= 1'b0;
@@ -378,32 +1268,36 @@ module z88_top
             // Internal RAM (Slot 0)
             if (RAM_DATA_WIDTH == 8) begin
                 r_ram_be_n  <= 2'b10;
-                r_ram_addr  <= (w_lcd_phy_addr[18:0] | w_cpu_phy_addr[18:0]) & RAM_ADDR_MASK[18:0];
+                r_ram_addr  <= (w_lcd_phy_addr[18:0] | w_cpu_phy_addr[18:0]) & RAM_MASK[18:0];
                 r_ram_rdata <= { 8'h00, ram_rdata[7:0] };
                 r_ram_wdata <= { 8'h00, w_z80_wdata };
             end
             else begin
                 r_ram_be_n  <= (w_lcd_phy_addr[0] | w_cpu_phy_addr[0]) ? 2'b01 : 2'b10;
-                r_ram_addr  <= { 1'b0, (w_lcd_phy_addr[18:1] | w_cpu_phy_addr[18:1]) & RAM_ADDR_MASK[18:1] };
+                r_ram_addr  <= { 1'b0, (w_lcd_phy_addr[18:1] | w_cpu_phy_addr[18:1]) & RAM_MASK[18:1]
+                                     | { w_shd_cpu | w_shd_lcd, 17'd0 } };
                 r_ram_rdata <= ram_rdata[15:0];
                 r_ram_wdata <= { w_z80_wdata, w_z80_wdata };
             end
-            // Internal ROM (Slot 0)
+            // Internal ROM (Slot 0), ROM cache background read (whole word)
             if (ROM_DATA_WIDTH == 8) begin
                 r_rom_be_n  <= 2'b10;
-                r_rom_addr  <= w_lcd_phy_addr[18:0] | w_cpu_phy_addr[18:0];
+                r_rom_addr  <= (r_clk_ena[1] & w_rc_bg | r_rc_bgw) ? w_rc_bgadr
+                             : w_lcd_phy_addr[18:0] | w_cpu_phy_addr[18:0];
                 r_rom_rdata <= { 8'h00, rom_rdata[7:0] };
             end
             else begin
-                r_rom_be_n  <= (w_lcd_phy_addr[0] | w_cpu_phy_addr[0]) ? 2'b01 : 2'b10;
-                r_rom_addr  <= { 1'b0, w_lcd_phy_addr[18:1] | w_cpu_phy_addr[18:1] };
+                r_rom_be_n  <= (r_clk_ena[1] & w_rc_bg | r_rc_bgw) ? 2'b00
+                             : (w_lcd_phy_addr[0] | w_cpu_phy_addr[0]) ? 2'b01 : 2'b10;
+                r_rom_addr  <= (r_clk_ena[1] & w_rc_bg | r_rc_bgw) ? w_rc_bgadr
+                             : { 1'b0, w_lcd_phy_addr[18:1] | w_cpu_phy_addr[18:1] };
                 r_rom_rdata <= rom_rdata[15:0];
             end
 
             // Z80 data read
             casez ({ v_cpu_ram_rd, v_cpu_rom_rd, v_cpu_byte })
                 3'b00? : if (w_z80_io_rd)
-                             r_z80_rdata <= w_blk_rdata[ 7:0];
+                             r_z80_rdata <= (w_pct_io) ? r_pct_rdata : w_blk_rdata[ 7:0];
                          else if (r_ext_cs_n != 3'b111)
                              r_z80_rdata <= 8'h00;
                 3'b010 : if (r_clk_ena[2]) r_z80_rdata <= r_rom_rdata[ 7:0];
@@ -411,6 +1305,14 @@ module z88_top
                 3'b1?0 : if (r_clk_ena[0]) r_z80_rdata <= r_ram_rdata[ 7:0];
                 3'b1?1 : if (r_clk_ena[0]) r_z80_rdata <= r_ram_rdata[15:8];
             endcase
+            // Z80 data read from the prefetch buffer
+            if (r_clk_ena[2] & r_pfb_hit) begin
+                r_z80_rdata <= (r_pfb_byte) ? r_pfb_data[15:8] : r_pfb_data[7:0];
+            end
+            // Z80 data read from the ROM cache
+            if (r_clk_ena[2] & r_rc_hit) begin
+                r_z80_rdata <= (r_rc_byte & (ROM_DATA_WIDTH != 8)) ? r_rc_dq[15:8] : r_rc_dq[7:0];
+            end
             // LCD data read
             casez ({ v_lcd_ram_rd, v_lcd_rom_rd, v_lcd_byte })
                 3'b00? :                   r_lcd_rdata <= 8'h00;
@@ -423,18 +1325,43 @@ module z88_top
         end
     end
 
-    // Internal RAM (Slot 0)
-    assign ram_ce_n  = r_ram_cs_n;
-    assign ram_we_n  = r_ext_we_n;
-    assign ram_oe_n  = r_ext_oe_n;
-    assign ram_be_n  = r_ram_be_n;
-    assign ram_addr  = r_ram_addr[18:0];
-    assign ram_wdata = r_ram_wdata;
+    // Internal RAM (Slot 0), shadow ROM copy
+    assign ram_ce_n  = (r_shd_run) ? r_shd_wr_n : r_ram_cs_n;
+    assign ram_we_n  = (r_shd_run) ? r_shd_wr_n : r_ext_we_n;
+    assign ram_oe_n  = (r_shd_run) ? 1'b1       : r_ext_oe_n;
+    assign ram_be_n  = (r_shd_run) ? 2'b00      : r_ram_be_n;
+    assign ram_addr  = (r_shd_run) ? { 2'b01, r_shd_wadr } : r_ram_addr[18:0];
+    assign ram_wdata = (r_shd_run) ? r_shd_dat  : r_ram_wdata;
 
     // Internal ROM (Slot 0)
-    assign rom_ce_n  = r_rom_cs_n;
-    assign rom_oe_n  = r_ext_oe_n;
-    assign rom_be_n  = r_rom_be_n;
-    assign rom_addr  = r_rom_addr[18:0];
+    assign rom_ce_n  = (r_shd_run) ? r_shd_rd_n : r_rom_cs_n;
+    assign rom_oe_n  = (r_shd_run) ? r_shd_rd_n : r_ext_oe_n;
+    assign rom_be_n  = (r_shd_run) ? ((ROM_DATA_WIDTH == 8) ? 2'b10 : 2'b00) : r_rom_be_n;
+    assign rom_addr  = (r_shd_run) ? ((ROM_DATA_WIDTH == 8) ? r_shd_adr : { 1'b0, r_shd_adr[18:1] })
+                                   : r_rom_addr[18:0];
+
+    // ========================================================================
+    // Debug probe (simulation only)
+    // ========================================================================
+
+    // 32-bit words read by the testbench (see z88_probe.h) :
+    // 0 : SP, PC           1 : BC, AF           2 : HL, DE        3 : IY, IX
+    // 4 : SR3 - SR0        5 : COM, data read by the Z80, Z80 address
+    // 6 : Z80 / frame flags, VRAM write        7 : PC trace buffer state
+    // 8 : ROM cache hits   9 : ROM cache misses
+    // 10 - 18 : Blink performance counters 0 - 8
+
+`ifdef verilator3
+    assign dbg_probe[127:0]   = w_z80_dbg_regs;
+    assign dbg_probe[159:128] = w_blk_mmu_regs[31:0];
+    assign dbg_probe[191:160] = { w_blk_mmu_regs[39:32], w_z80_di, w_z80_addr };
+    assign dbg_probe[223:192] = { 2'b00, w_vga_fr_tgl, w_lcd_vram_we,
+                                  w_z80_clk_ena, w_z80_halt_n, w_z80_mreq_n, w_z80_m1_n,
+                                  5'b00000, w_lcd_vram_data, 1'b0, w_lcd_vram_addr };
+    assign dbg_probe[255:224] = { r_pct_frz, r_pct_full, 14'd0, r_pct_wrp };
+    assign dbg_probe[287:256] = r_rc_hits;
+    assign dbg_probe[319:288] = r_rc_miss;
+    assign dbg_probe[607:320] = w_blk_perf_cnt;
+`endif
 
 endmodule